@@ -1,264 +1,1287 @@
-#include <array>
-#include <algorithm>
-#include <cassert>
-#include <cmath>
-#include <iostream>
-#include <iomanip>
-#include <type_traits>
+#include "RC5.hpp"
+#include "RC5Analysis.hpp"
+#include "RC5Container.hpp"
+#include "RC5Jit.hpp"
+#include "RC5Lazy.hpp"
+#include "RC5Literal.hpp"
+#include "RC5Metrics.hpp"
+#include "RC5Parallel.hpp"
+#include "RC5Pipeline.hpp"
+#include "RC5Search.hpp"
+#include "RC5SearchCluster.hpp"
+#include "RC5SearchRunner.hpp"
+#include "RC5Simd.hpp"
+#include "RC5Stream.hpp"
 
-using namespace std;
+#include <fstream>
+#include <optional>
+#include <random>
+#include <set>
+#include <sstream>
+#include <thread>
 
-//////// UTILITY TEMPLATES
+//////// TESTS
 
-template <uint8_t w>
-struct WordT
+// constexpr comparison for containers supporting `size()` and random indexing
+template <typename ContainerType>
+constexpr bool constexpr_compare(const ContainerType &c1, const ContainerType &c2)
 {
-    // any RC5 cipher with w different from 16, 32, 64 will fail to compile
-    using type = void;
-};
+    if (c1.size() != c2.size())
+        return false;
+
+    for (int i = 0; i < c1.size(); ++i)
+        if (c1[i] != c2[i])
+            return false;
 
-template <>
-struct WordT<16>
+    return true;
+}
+
+void test1()
 {
-    using type = uint16_t;
-    static constexpr type P = 0xb7e1;
-    static constexpr type Q = 0x9e37;
-};
+    constexpr std::array<uint8_t, 16> key = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F};
+    constexpr std::array<uint8_t, 8> plaintext = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77};
+    constexpr std::array<uint8_t, 8> ciphertext = {0x2D, 0xDC, 0x14, 0x9B, 0xCF, 0x08, 0x8B, 0x9E};
 
-template <>
-struct WordT<32>
+    // the following RC5 encoding is done during COMPILE time
+    constexpr auto res = RC5<32, 12, 16>::encode(key, plaintext);
+    static_assert(constexpr_compare(res, ciphertext));
+
+    // the following RC5 encoding is done during RUNTIME
+    assert((RC5<32, 12, 16>::encode(key, plaintext) == ciphertext));
+}
+
+void test2()
 {
-    using type = uint32_t;
-    static constexpr type P = 0xb7e15163;
-    static constexpr type Q = 0x9e3779b9;
-};
+    constexpr std::array<uint8_t, 16> key = {0x2B, 0xD6, 0x45, 0x9F, 0x82, 0xC5, 0xB3, 0x00, 0x95, 0x2C, 0x49, 0x10, 0x48, 0x81, 0xFF, 0x48};
+    constexpr std::array<uint8_t, 8> plaintext = {0xEA, 0x02, 0x47, 0x14, 0xAD, 0x5C, 0x4D, 0x84};
+    constexpr std::array<uint8_t, 8> ciphertext = {0x11, 0xE4, 0x3B, 0x86, 0xD2, 0x31, 0xEA, 0x64};
+    constexpr auto res = RC5<32, 12, 16>::encode(key, plaintext);
+    static_assert(constexpr_compare(res, ciphertext));
+}
 
-template <>
-struct WordT<64>
+void test3()
 {
-    using type = uint64_t;
-    static constexpr type P = 0xb7e151628aed2a6b;
-    static constexpr type Q = 0x9e3779b97f4a7c15;
-};
+    constexpr std::array<uint8_t, 16> key = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F};
+    constexpr std::array<uint8_t, 8> plaintext = {0x96, 0x95, 0x0D, 0xDA, 0x65, 0x4A, 0x3D, 0x62};
+    constexpr std::array<uint8_t, 8> ciphertext = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77};
+    constexpr auto res = RC5<32, 12, 16>::decode(key, ciphertext);
+    static_assert(constexpr_compare(res, plaintext));
+}
+
+void test4()
+{
+    constexpr std::array<uint8_t, 16> key = {0x2B, 0xD6, 0x45, 0x9F, 0x82, 0xC5, 0xB3, 0x00, 0x95, 0x2C, 0x49, 0x10, 0x48, 0x81, 0xFF, 0x48};
+    constexpr std::array<uint8_t, 8> plaintext = {0x63, 0x8B, 0x3A, 0x5E, 0xF7, 0x2B, 0x66, 0x3F};
+    constexpr std::array<uint8_t, 8> ciphertext = {0xEA, 0x02, 0x47, 0x14, 0xAD, 0x5C, 0x4D, 0x84};
+    constexpr auto res = RC5<32, 12, 16>::decode(key, ciphertext);
+    static_assert(constexpr_compare(res, plaintext));
+}
+
+// cipher with w = 64
+void test5()
+{
+    constexpr std::array<uint8_t, 24> key = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17};
+    ;
+    constexpr std::array<uint8_t, 16> plaintext = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F};
+    constexpr std::array<uint8_t, 16> ciphertext = {0xA4, 0x67, 0x72, 0x82, 0x0E, 0xDB, 0xCE, 0x02, 0x35, 0xAB, 0xEA, 0x32, 0xAE, 0x71, 0x78, 0xDA};
+    constexpr auto res = RC5<64, 24, 24>::encode(key, plaintext);
+    static_assert(constexpr_compare(res, ciphertext));
+}
+
+// cipher with L = 0 (result is not compared, as I found no test vectors with L = 0)
+void test6()
+{
+    constexpr std::array<uint8_t, 0> key = {};
+    constexpr std::array<uint8_t, 16> plaintext = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F};
+    constexpr std::array<uint8_t, 16> ciphertext = {0xA4, 0x67, 0x72, 0x82, 0x0E, 0xDB, 0xCE, 0x02, 0x35, 0xAB, 0xEA, 0x32, 0xAE, 0x71, 0x78, 0xDA};
+    RC5<64, 24, 0>::encode(key, plaintext);
+}
+
+// cipher with the key fixed at compile time must agree with the generic one
+void test7()
+{
+    static constexpr std::array<uint8_t, 16> key = {0x2B, 0xD6, 0x45, 0x9F, 0x82, 0xC5, 0xB3, 0x00, 0x95, 0x2C, 0x49, 0x10, 0x48, 0x81, 0xFF, 0x48};
+    constexpr std::array<uint8_t, 8> plaintext = {0xEA, 0x02, 0x47, 0x14, 0xAD, 0x5C, 0x4D, 0x84};
+    constexpr std::array<uint8_t, 8> ciphertext = {0x11, 0xE4, 0x3B, 0x86, 0xD2, 0x31, 0xEA, 0x64};
+    using Fixed = RC5Fixed<32, 12, key>;
+
+    static_assert(constexpr_compare(Fixed::encode(plaintext), ciphertext));
+    static_assert(constexpr_compare(Fixed::decode(ciphertext), plaintext));
+    assert((Fixed::encode(plaintext) == ciphertext));
+    assert((Fixed::decode(ciphertext) == plaintext));
+
+    static constexpr std::array<uint8_t, 24> key64 = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17};
+    constexpr std::array<uint8_t, 16> plaintext64 = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F};
+    static_assert(constexpr_compare(RC5Fixed<64, 24, key64>::encode(plaintext64), RC5<64, 24, 24>::encode(key64, plaintext64)));
+}
+
+// runtime facade must agree with the templates for both specialized and generic kernels
+void test8()
+{
+    constexpr std::array<uint8_t, 16> key = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F};
+    constexpr std::array<uint8_t, 8> plaintext = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77};
+    constexpr std::array<uint8_t, 8> ciphertext = {0x2D, 0xDC, 0x14, 0x9B, 0xCF, 0x08, 0x8B, 0x9E};
 
-//////// RC5 cipher
+    RC5Cipher cipher(32, 12, key.data(), key.size());
+    assert(cipher.specialized() && cipher.blockSize() == 8);
+    std::array<uint8_t, 8> block = plaintext;
+    cipher.encode(block.data(), block.data(), 1);
+    assert(block == ciphertext);
+    cipher.decode(block.data(), block.data(), 1);
+    assert(block == plaintext);
 
+    RC5Cipher generic(32, 13, key.data(), key.size());
+    assert(!generic.specialized());
+    std::array<uint8_t, 16> blocks = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77};
+    generic.encode(blocks.data(), blocks.data(), 2);
+    constexpr auto expected = RC5<32, 13, 16>::encode(key, plaintext);
+    assert(equal(expected.begin(), expected.end(), blocks.begin()));
+    assert(equal(expected.begin(), expected.end(), blocks.begin() + 8));
+    generic.decode(blocks.data(), blocks.data(), 2);
+    assert(equal(plaintext.begin(), plaintext.end(), blocks.begin() + 8));
+
+    constexpr std::array<uint8_t, 24> key64 = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17};
+    std::array<uint8_t, 16> block64 = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F};
+    RC5Cipher(64, 24, key64.data(), key64.size()).encode(block64.data(), block64.data(), 1);
+    assert((block64 == std::array<uint8_t, 16>{0xA4, 0x67, 0x72, 0x82, 0x0E, 0xDB, 0xCE, 0x02, 0x35, 0xAB, 0xEA, 0x32, 0xAE, 0x71, 0x78, 0xDA}));
+}
+
+#if defined(__x86_64__)
+// generated code must match the generic kernel, in both directions and in place
 template <uint8_t w, uint8_t r, uint8_t b>
-class RC5
+void testJit(const std::array<uint8_t, b> &key)
 {
-    // there is no need to check the cipher parameters with static_assert, as
-    // the template construction/data types will make sure that
-    // 0 <= r <= 255 (enforced by data type)
-    // 0 <= b <= 255 (enforced by data type)
-    // w can only be 16, 32, 64 (enforced by WordT template)
-    // K has exactly b bytes (enforced by Key data type)
+    using Cipher = RC5<w, r, b>;
+    const auto S = Cipher::setupS(key);
+    RC5Jit<w> jit(S.data(), r);
 
-private:
-    // set the underlying type for word based on w
-    using Word = typename WordT<w>::type;
-    using Key = array<uint8_t, b>;
+    std::array<uint8_t, 2 * Cipher::u * 17> data{}, expected{}, actual{};
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = uint8_t(i * 151 + 7);
 
-    // constants derived from cipher's parameters
-    static constexpr uint8_t u = ceil(w / 8);
-    static constexpr uint16_t t = 2 * (r + 1);
+    Cipher::encodeBlocks(S, data.data(), expected.data(), 17);
+    jit.encode(data.data(), actual.data(), 17);
+    assert(actual == expected);
+    jit.decode(actual.data(), actual.data(), 17);
+    assert(actual == data);
+    jit.encode(actual.data(), actual.data(), 0);
+    assert(actual == data);
+}
 
-    // set magic numbers based on w
-    static constexpr Word P = WordT<w>::P;
-    static constexpr Word Q = WordT<w>::Q;
+void test9()
+{
+    constexpr std::array<uint8_t, 16> key = {0x2B, 0xD6, 0x45, 0x9F, 0x82, 0xC5, 0xB3, 0x00, 0x95, 0x2C, 0x49, 0x10, 0x48, 0x81, 0xFF, 0x48};
+    testJit<16, 16, 16>(key);
+    testJit<32, 12, 16>(key);
+    testJit<32, 0, 16>(key);
+    testJit<64, 24, 16>(key);
+}
+#endif
 
-public:
+// cipher with w = 128
+void test10()
+{
+    constexpr std::array<uint8_t, 32> key = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F};
+    constexpr std::array<uint8_t, 32> plaintext = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F};
+    constexpr std::array<uint8_t, 32> ciphertext = {0xEC, 0xA5, 0x91, 0x09, 0x21, 0xA4, 0xF4, 0xCF, 0xDD, 0x7A, 0xD7, 0xAD, 0x20, 0xA1, 0xFC, 0xBA, 0x06, 0x8E, 0xC7, 0xA7, 0xCD, 0x75, 0x2D, 0x68, 0xFE, 0x91, 0x4B, 0x7F, 0xE1, 0x80, 0xB4, 0x40};
+    constexpr auto res = RC5<128, 28, 32>::encode(key, plaintext);
+    static_assert(constexpr_compare(res, ciphertext));
+    static_assert(constexpr_compare(RC5<128, 28, 32>::decode(key, ciphertext), plaintext));
 
-    template <typename ByteStream>
-    static constexpr ByteStream encode(const Key &K, const ByteStream &plaintext)
-    {
-        // checking if padding on plaintext is correct
-        static_assert(plaintext.size() == u * 2);
+    std::array<uint8_t, 32> block = plaintext;
+    RC5Cipher cipher(128, 28, key.data(), key.size());
+    cipher.encode(block.data(), block.data(), 1);
+    assert(block == ciphertext);
+    cipher.decode(block.data(), block.data(), 1);
+    assert(block == plaintext);
+}
+
+// vector kernel must match the scalar one, including the scalar tail
+template <uint8_t w, uint8_t r, uint8_t b>
+void testSimd(const std::array<uint8_t, b> &key)
+{
+    using Cipher = RC5<w, r, b>;
+    using Simd = RC5Simd<w, r, b>;
+    constexpr size_t blocks = 3 * Simd::lanes + 1;
+    const auto S = Cipher::setupS(key);
+
+    std::array<uint8_t, 2 * Cipher::u * blocks> data{}, expected{}, actual{};
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = uint8_t(i * 151 + 7);
 
-        ByteStream ciphertext{};
-        Word A = packWord(plaintext, 0);
-        Word B = packWord(plaintext, u);
-        encodeWords(K, A, B);
-        unpackWord(ciphertext, 0, A);
-        unpackWord(ciphertext, u, B);
+    Cipher::encodeBlocks(S, data.data(), expected.data(), blocks);
+    Simd::encodeBlocks(S, data.data(), actual.data(), blocks);
+    assert(actual == expected);
+    Simd::decodeBlocks(S, actual.data(), actual.data(), blocks);
+    assert(actual == data);
+}
+
+void test11()
+{
+    constexpr std::array<uint8_t, 16> key = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F};
+    testSimd<16, 16, 16>(key);
+    testSimd<32, 12, 16>(key);
+    testSimd<64, 24, 16>(key);
+}
 
-        return ciphertext;
+// published known-answer vectors: Rivest's five RC5-32/12/16 vectors, each
+// ciphertext feeding the next plaintext, and the RC5-16/16/8 and RC5-32/20/16
+// vectors from the same draft as test5 and test10
+void test12()
+{
+    constexpr std::array<std::array<uint8_t, 16>, 5> keys = {{
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+        {0x91, 0x5F, 0x46, 0x19, 0xBE, 0x41, 0xB2, 0x51, 0x63, 0x55, 0xA5, 0x01, 0x10, 0xA9, 0xCE, 0x91},
+        {0x78, 0x33, 0x48, 0xE7, 0x5A, 0xEB, 0x0F, 0x2F, 0xD7, 0xB1, 0x69, 0xBB, 0x8D, 0xC1, 0x67, 0x87},
+        {0xDC, 0x49, 0xDB, 0x13, 0x75, 0xA5, 0x58, 0x4F, 0x64, 0x85, 0xB4, 0x13, 0xB5, 0xF1, 0x2B, 0xAF},
+        {0x52, 0x69, 0xF1, 0x49, 0xD4, 0x1B, 0xA0, 0x15, 0x24, 0x97, 0x57, 0x4D, 0x7F, 0x15, 0x31, 0x25},
+    }};
+    constexpr std::array<std::array<uint8_t, 8>, 6> chain = {{
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+        {0x21, 0xA5, 0xDB, 0xEE, 0x15, 0x4B, 0x8F, 0x6D},
+        {0xF7, 0xC0, 0x13, 0xAC, 0x5B, 0x2B, 0x89, 0x52},
+        {0x2F, 0x42, 0xB3, 0xB7, 0x03, 0x69, 0xFC, 0x92},
+        {0x65, 0xC1, 0x78, 0xB2, 0x84, 0xD1, 0x97, 0xCC},
+        {0xEB, 0x44, 0xE4, 0x15, 0xDA, 0x31, 0x98, 0x24},
+    }};
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        assert((RC5<32, 12, 16>::encode(keys[i], chain[i]) == chain[i + 1]));
+        assert((RC5<32, 12, 16>::decode(keys[i], chain[i + 1]) == chain[i]));
     }
+    static_assert(constexpr_compare(RC5<32, 12, 16>::encode(keys[4], chain[4]), chain[5]));
+
+    constexpr std::array<uint8_t, 8> key16 = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07};
+    constexpr std::array<uint8_t, 4> plaintext16 = {0x00, 0x01, 0x02, 0x03};
+    constexpr std::array<uint8_t, 4> ciphertext16 = {0x23, 0xA8, 0xD7, 0x2E};
+    static_assert(constexpr_compare(RC5<16, 16, 8>::encode(key16, plaintext16), ciphertext16));
+
+    constexpr std::array<uint8_t, 16> key32 = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F};
+    constexpr std::array<uint8_t, 8> plaintext32 = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07};
+    constexpr std::array<uint8_t, 8> ciphertext32 = {0x2A, 0x0E, 0xDC, 0x0E, 0x94, 0x31, 0xFF, 0x73};
+    static_assert(constexpr_compare(RC5<32, 20, 16>::encode(key32, plaintext32), ciphertext32));
+}
 
-    static constexpr void encodeWords(const Key& K, Word &A, Word &B)
+//////// DIFFERENTIAL TESTS
+
+// every optimized backend against the block-by-block encodeWords/decodeWords
+// reference, with random keys, block counts and unaligned buffer offsets
+template <uint8_t w, uint8_t r, uint8_t b>
+void differential(std::mt19937 &rng, int iterations)
+{
+    using Cipher = RC5<w, r, b>;
+    constexpr size_t blockSize = 2 * Cipher::u;
+    static constexpr auto fixedKey = [] {
+        std::array<uint8_t, b> key{};
+        for (size_t i = 0; i < b; ++i)
+            key[i] = uint8_t(i * 73 + 5);
+        return key;
+    }();
+
+    for (int iteration = 0; iteration < iterations; ++iteration)
     {
-        const array<Word, t> S = setupS(K);
+        typename Cipher::Key key;
+        for (auto &byte : key)
+            byte = uint8_t(rng());
+        if (iteration == 0)
+            key = fixedKey;
+        const auto S = Cipher::setupS(key);
+
+        const size_t blocks = rng() % 40;
+        const size_t bytes = blocks * blockSize;
+        const size_t inOffset = rng() % 16, outOffset = rng() % 16;
+        std::vector<uint8_t> plaintext(bytes), expected(bytes);
+        for (auto &byte : plaintext)
+            byte = uint8_t(rng());
 
-        A += S[0];
-        B += S[1];
+        for (size_t k = 0; k < bytes; k += blockSize)
+        {
+            typename Cipher::Word A = Cipher::packWord(plaintext, k);
+            typename Cipher::Word B = Cipher::packWord(plaintext, k + Cipher::u);
+            Cipher::encodeWords(S, A, B);
+            Cipher::unpackWord(expected, k, A);
+            Cipher::unpackWord(expected, k + Cipher::u, B);
+        }
+
+        // runs one backend on unaligned copies and compares both directions
+        std::vector<uint8_t> in(bytes + 16), out(bytes + 16);
+        auto check = [&](auto &&encode, auto &&decode) {
+            std::copy(plaintext.begin(), plaintext.end(), in.begin() + inOffset);
+            encode(in.data() + inOffset, out.data() + outOffset, blocks);
+            assert(std::equal(expected.begin(), expected.end(), out.begin() + outOffset));
+            decode(out.data() + outOffset, out.data() + outOffset, blocks);
+            assert(std::equal(plaintext.begin(), plaintext.end(), out.begin() + outOffset));
+        };
+
+        check([&](auto... args) { Cipher::encodeBlocks(S, args...); }, [&](auto... args) { Cipher::decodeBlocks(S, args...); });
+
+        const RC5Cipher cipher(w, r, key.data(), b);
+        check([&](auto... args) { cipher.encode(args...); }, [&](auto... args) { cipher.decode(args...); });
 
-        for (uint8_t i = 1; i <= r; ++i)
+        if (iteration == 0)
+            check([&](auto... args) { RC5Fixed<w, r, fixedKey>::encodeBlocks(args...); }, [&](auto... args) { RC5Fixed<w, r, fixedKey>::decodeBlocks(args...); });
+
+        if constexpr (w <= 64)
         {
-            A = left_shift(A ^ B, B) + S[2 * i];
-            B = left_shift(B ^ A, A) + S[2 * i + 1];
+#if defined(__x86_64__)
+            const RC5Jit<w> jit(S.data(), r);
+            check([&](auto... args) { jit.encode(args...); }, [&](auto... args) { jit.decode(args...); });
+#endif
+            check([&](auto... args) { RC5Simd<w, r, b>::encodeBlocks(S, args...); }, [&](auto... args) { RC5Simd<w, r, b>::decodeBlocks(S, args...); });
         }
     }
+}
+
+template <uint8_t w, uint8_t r>
+void differentialKeys(std::mt19937 &rng)
+{
+    differential<w, r, 0>(rng, 4);
+    differential<w, r, 7>(rng, 4);
+    differential<w, r, 16>(rng, 4);
+    differential<w, r, 255>(rng, 4);
+}
 
-    template <typename ByteStream>
-    static constexpr ByteStream decode(const Key& K, const ByteStream &ciphertext)
+template <uint8_t w>
+void differentialRounds(std::mt19937 &rng)
+{
+    differentialKeys<w, 0>(rng);
+    differentialKeys<w, 1>(rng);
+    differentialKeys<w, 12>(rng);
+    differentialKeys<w, 255>(rng);
+}
+
+void test13()
+{
+    std::mt19937 rng(2040);
+    differentialRounds<16>(rng);
+    differentialRounds<32>(rng);
+    differentialRounds<64>(rng);
+    differentialRounds<128>(rng);
+
+#if defined(__x86_64__)
+    // (w, r, b) drawn at runtime: RC5Cipher (specialized or generic engine)
+    // against a JIT built from the engine's key schedule
+    for (int iteration = 0; iteration < 200; ++iteration)
     {
-        // checking if padding on ciphertext is correct
-        static_assert(ciphertext.size() == u * 2);
+        const uint8_t w = 16 << (rng() % 3);
+        const uint8_t r = rng() % 256, b = rng() % 256;
+        std::vector<uint8_t> key(b);
+        for (auto &byte : key)
+            byte = uint8_t(rng());
+        const size_t blocks = rng() % 8, bytes = blocks * w / 4;
+        std::vector<uint8_t> plaintext(bytes), expected(bytes), actual(bytes);
+        for (auto &byte : plaintext)
+            byte = uint8_t(rng());
+
+        const RC5Cipher cipher(w, r, key.data(), b);
+        cipher.encode(plaintext.data(), expected.data(), blocks);
+        auto viaJit = [&](auto word) {
+            constexpr uint8_t width = decltype(word)::value;
+            std::vector<typename RC5Engine<width>::Word> S(2 * (r + 1));
+            RC5Engine<width>::setupS(key.data(), b, r, S.data());
+            RC5Jit<width>(S.data(), r).encode(plaintext.data(), actual.data(), blocks);
+        };
+        if (w == 16)
+            viaJit(std::integral_constant<uint8_t, 16>{});
+        else if (w == 32)
+            viaJit(std::integral_constant<uint8_t, 32>{});
+        else
+            viaJit(std::integral_constant<uint8_t, 64>{});
+        assert(actual == expected);
+    }
+#endif
+}
+
+// counters from several threads, including exited ones, add up in the snapshot and the dump
+void test14()
+{
+    const MetricValues before = metricsSnapshot();
+    metricsAdd(MetricBlocksEncrypted, 3);
+    std::thread([] {
+        metricsAdd(MetricBlocksEncrypted, 4);
+        metricsAdd(MetricBytesEcb, 64);
+    }).join();
+    const MetricValues after = metricsSnapshot();
+    assert(after[MetricBlocksEncrypted] - before[MetricBlocksEncrypted] == 7);
+    assert(after[MetricBytesEcb] - before[MetricBytesEcb] == 64);
+
+    const std::string path = "rc5_test_metrics.prom";
+    assert(metricsWritePrometheus(path));
+    std::stringstream dump;
+    dump << std::ifstream(path).rdbuf();
+    std::remove(path.c_str());
+    assert(dump.str().find("# TYPE rc5_bytes_total counter\nrc5_bytes_total{mode=\"ecb\"} " + std::to_string(after[MetricBytesEcb]) + "\n") != std::string::npos);
+
+#if defined(RC5_METRICS)
+    // the hooks in the library itself, only there with -DRC5_METRICS
+    const MetricValues start = metricsSnapshot();
+    const std::array<uint8_t, 16> key = {1, 2, 3};
+    RC5Cipher cipher(32, 12, key.data(), key.size());
+    std::vector<uint8_t> data(5 * cipher.blockSize());
+    cipher.encode(data.data(), data.data(), 5);
+    cipher.decode(data.data(), data.data(), 3);
+    const auto S = RC5<32, 12, 16>::setupS(key);
+    RC5Cbc<32, 12, 16>::encrypt(S, {}, data.data(), data.data(), 2);
+    RC5Ctr<32, 12, 16>::crypt(S, {}, 0, data.data(), data.data(), 13);
+    const MetricValues end = metricsSnapshot();
+    assert(end[MetricKeysExpanded] - start[MetricKeysExpanded] == 1);
+    assert(end[MetricBlocksEncrypted] - start[MetricBlocksEncrypted] == 5);
+    assert(end[MetricBlocksDecrypted] - start[MetricBlocksDecrypted] == 3);
+    assert(end[MetricBytesEcb] - start[MetricBytesEcb] == 8 * 8);
+    assert(end[MetricBytesCbc] - start[MetricBytesCbc] == 16);
+    assert(end[MetricBytesCtr] - start[MetricBytesCtr] == 13);
+#endif
+}
+
+//////// MODES AND ENCRYPTED LITERALS
 
-        ByteStream plaintext{};
-        Word A = packWord(ciphertext, 0);
-        Word B = packWord(ciphertext, u);
-        decodeWords(K, A, B);
-        unpackWord(plaintext, 0, A);
-        unpackWord(plaintext, u, B);
+constexpr std::array<uint8_t, 16> literalKey = {0x52, 0x69, 0xF1, 0x49, 0xD4, 0x1B, 0xA0, 0x15, 0x24, 0x97, 0x57, 0x4D, 0x7F, 0x15, 0x31, 0x25};
+
+// one RC5-CBC block from the RFC 2040 test vectors (section 8), both ways
+template <uint8_t r, uint8_t b>
+void rfc2040Cbc(const std::array<uint8_t, b> &key, const std::array<uint8_t, 8> &iv, const std::array<uint8_t, 8> &plain,
+                const std::array<uint8_t, 8> &expected)
+{
+    const auto S = RC5<32, r, b>::setupS(key);
+    std::array<uint8_t, 8> cipher, back;
+    RC5Cbc<32, r, b>::encrypt(S, iv, plain.data(), cipher.data(), 1);
+    RC5Cbc<32, r, b>::decrypt(S, iv, cipher.data(), back.data(), 1);
+    assert(cipher == expected && back == plain);
+}
+
+void test15()
+{
+    constexpr std::array<uint8_t, 8> zero{}, ones = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    constexpr std::array<uint8_t, 8> one = {0, 0, 0, 0, 0, 0, 0, 1}, rfcIv = {1, 2, 3, 4, 5, 6, 7, 8};
+    constexpr std::array<uint8_t, 8> rfcPlain = {0x10, 0x20, 0x30, 0x40, 0x50, 0x60, 0x70, 0x80};
+    rfc2040Cbc<0, 1>({0x00}, zero, zero, {0x7a, 0x7b, 0xba, 0x4d, 0x79, 0x11, 0x1d, 0x1e});
+    rfc2040Cbc<0, 1>({0x00}, zero, ones, {0x79, 0x7b, 0xba, 0x4d, 0x78, 0x11, 0x1d, 0x1e});
+    rfc2040Cbc<0, 1>({0x00}, one, zero, {0x7a, 0x7b, 0xba, 0x4d, 0x79, 0x11, 0x1d, 0x1f});
+    rfc2040Cbc<0, 1>({0x00}, zero, one, {0x7a, 0x7b, 0xba, 0x4d, 0x79, 0x11, 0x1d, 0x1f});
+    rfc2040Cbc<0, 1>({0x00}, rfcIv, rfcPlain, {0x8b, 0x9d, 0xed, 0x91, 0xce, 0x77, 0x94, 0xa6});
+    rfc2040Cbc<1, 1>({0x11}, zero, zero, {0x2f, 0x75, 0x9f, 0xe7, 0xad, 0x86, 0xa3, 0x78});
+    rfc2040Cbc<2, 1>({0x00}, zero, zero, {0xdc, 0xa2, 0x69, 0x4b, 0xf4, 0x0e, 0x07, 0x88});
+    rfc2040Cbc<2, 4>({0x00, 0x00, 0x00, 0x00}, zero, zero, {0xdc, 0xa2, 0x69, 0x4b, 0xf4, 0x0e, 0x07, 0x88});
+    rfc2040Cbc<8, 1>({0x00}, zero, zero, {0xdc, 0xfe, 0x09, 0x85, 0x77, 0xec, 0xa5, 0xff});
+    rfc2040Cbc<8, 1>({0x00}, rfcIv, rfcPlain, {0x96, 0x46, 0xfb, 0x77, 0x63, 0x8f, 0x9c, 0xa8});
+    rfc2040Cbc<12, 1>({0x00}, rfcIv, rfcPlain, {0xb2, 0xb3, 0x20, 0x9d, 0xb6, 0x59, 0x4d, 0xa4});
+    rfc2040Cbc<16, 1>({0x00}, rfcIv, rfcPlain, {0x54, 0x5f, 0x7f, 0x32, 0xa5, 0xfc, 0x38, 0x36});
+    rfc2040Cbc<8, 8>({1, 2, 3, 4, 5, 6, 7, 8}, rfcIv, rfcPlain, {0x5c, 0x4c, 0x04, 0x1e, 0x0f, 0x21, 0x7a, 0xc3});
+    rfc2040Cbc<12, 8>({1, 2, 3, 4, 5, 6, 7, 8}, rfcIv, rfcPlain, {0x92, 0x1f, 0x12, 0x48, 0x53, 0x73, 0xb4, 0xf7});
 
-        return plaintext;
+    // RC5-CBC-Pad: a whole block gains a block of eight 08s, and the first
+    // block is the RC5-CBC vector above
+    {
+        using PadCbc = RC5Cbc<32, 12, 1>;
+        const auto S = RC5<32, 12, 1>::setupS({0x00});
+        std::array<uint8_t, PadCbc::paddedSize(8)> padded{}, cipher, back;
+        std::copy(rfcPlain.begin(), rfcPlain.end(), padded.begin());
+        std::fill(padded.begin() + 8, padded.end(), uint8_t(padded.size() - 8));
+        PadCbc::encrypt(S, rfcIv, padded.data(), cipher.data(), 2);
+        assert((std::equal(cipher.begin(), cipher.begin() + 8, std::array<uint8_t, 8>{0xb2, 0xb3, 0x20, 0x9d, 0xb6, 0x59, 0x4d, 0xa4}.begin())));
+        std::array<uint8_t, 8> last;
+        PadCbc::encrypt(S, {cipher[0], cipher[1], cipher[2], cipher[3], cipher[4], cipher[5], cipher[6], cipher[7]}, padded.data() + 8, last.data(), 1);
+        assert(std::equal(last.begin(), last.end(), cipher.begin() + 8));
+        PadCbc::decrypt(S, rfcIv, cipher.data(), back.data(), 2);
+        assert(back == padded && back[15] == 8);
     }
 
-    static constexpr void decodeWords(const Key& K, Word &A, Word &B)
+    using Cbc = RC5Cbc<32, 12, 16>;
+    using Ctr = RC5Ctr<32, 12, 16>;
+    const auto &S = RC5Fixed<32, 12, literalKey>::S;
+    constexpr Cbc::Block iv = {1, 2, 3, 4, 5, 6, 7, 8};
+
+    std::vector<uint8_t> plain(37), cipher(plain.size()), back(plain.size());
+    for (size_t i = 0; i < plain.size(); ++i)
+        plain[i] = uint8_t(i * 7);
+
+    Cbc::encrypt(S, iv, plain.data(), cipher.data(), 4);
+    Cbc::decrypt(S, iv, cipher.data(), back.data(), 4);
+    assert(std::equal(plain.begin(), plain.begin() + 32, back.begin()));
+    assert(Cbc::paddedSize(0) == 8 && Cbc::paddedSize(7) == 8 && Cbc::paddedSize(8) == 16);
+
+    // entering the keystream at block 3 matches the tail of a full pass
+    Ctr::crypt(S, iv, 0, plain.data(), cipher.data(), plain.size());
+    Ctr::crypt(S, iv, 3, plain.data() + 24, back.data() + 24, plain.size() - 24);
+    assert(std::equal(cipher.begin() + 24, cipher.end(), back.begin() + 24));
+    Ctr::crypt(S, iv, 0, cipher.data(), back.data(), plain.size());
+    assert(back == plain);
+    assert((Ctr::counter({0xFF, 0xFF, 0, 0, 0, 0, 0, 0}, 1) == Cbc::Block{0, 0, 1, 0, 0, 0, 0, 0}));
+
+    constexpr auto cbcLiteral = rc5EncryptString<32, 12, literalKey, RC5Mode::Cbc>("attack at dawn", 1);
+    constexpr auto ctrLiteral = rc5EncryptString<32, 12, literalKey, RC5Mode::Ctr>("attack at dawn", 1);
+    static_assert(cbcLiteral.ciphertext().size() == 16 && ctrLiteral.ciphertext().size() == 15);
+    static_assert(ctrLiteral.ciphertext()[0] != 'a');
+    static_assert(cbcLiteral.decrypt()[0] == 'a' && ctrLiteral.decrypt()[13] == 'n' && ctrLiteral.decrypt()[14] == 0);
+
+    assert(std::string(RC5_STRING(32, 12, literalKey, RC5Mode::Cbc, "open sesame")) == "open sesame");
+    assert(std::string(RC5_STRING(64, 16, literalKey, RC5Mode::Ctr, "")) == "");
+    static constexpr std::array<uint8_t, 5> bytes = {0xDE, 0xAD, 0xBE, 0xEF, 0x00};
+    assert(RC5_BYTES(16, 12, literalKey, RC5Mode::Ctr, bytes) == bytes);
+
+    // first access from several threads at once decrypts exactly one buffer
+    std::vector<std::thread> threads;
+    std::vector<const char *> seen(4);
+    for (size_t i = 0; i < seen.size(); ++i)
+        threads.emplace_back([&seen, i] { seen[i] = RC5_STRING(32, 12, literalKey, RC5Mode::Ctr, "shared secret"); });
+    for (std::thread &thread : threads)
+        thread.join();
+    for (const char *s : seen)
+        assert(s == seen[0] && std::string(s) == "shared secret");
+}
+
+//////// BULK CONSTANT EVALUATION
+
+constexpr std::array<uint8_t, 920> blobPlaintext = [] {
+    std::array<uint8_t, 920> bytes{};
+    for (size_t i = 0; i < bytes.size(); ++i)
+        bytes[i] = uint8_t(i * 13 + 1);
+    return bytes;
+}();
+
+void test16()
+{
+    // one key expansion for the whole array gives the same blocks as encode
+    constexpr std::array<uint8_t, 16> key = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F};
+    constexpr std::array<uint8_t, 16> plaintext = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07};
+    constexpr auto ciphertext = RC5<32, 20, 16>::encodeArray(key, plaintext);
+    static_assert(ciphertext[0] == 0x2A && ciphertext[7] == 0x73 && ciphertext[8] == 0x2A && ciphertext[15] == 0x73);
+    static_assert(constexpr_compare(RC5<32, 20, 16>::decodeArray(key, ciphertext), plaintext));
+    static_assert(constexpr_compare(RC5Fixed<32, 20, key>::encodeArray(plaintext), ciphertext));
+
+    // 230 blocks of RC5-16/255 are three chunks, the last one partial
+    constexpr std::array<uint8_t, 8> key16 = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07};
+    using Fixed = RC5Fixed<16, 255, key16>;
+    static_assert(Fixed::blobChunkBlocks < 230 && 2 * Fixed::blobChunkBlocks < 230 && 3 * Fixed::blobChunkBlocks > 230);
+    constexpr const auto &blob = Fixed::encodedBlob<blobPlaintext>;
+    static_assert(blob.size() == blobPlaintext.size());
+
+    std::vector<uint8_t> expected(blobPlaintext.size()), decoded(blobPlaintext.size());
+    RC5<16, 255, 8>::encodeBlocks(RC5<16, 255, 8>::setupS(key16), blobPlaintext.data(), expected.data(), 230);
+    assert(std::equal(expected.begin(), expected.end(), blob.data()));
+    Fixed::decodeBlocks(blob.data(), decoded.data(), 230);
+    assert(std::equal(decoded.begin(), decoded.end(), blobPlaintext.begin()));
+}
+
+//////// KEY SEARCH
+
+template <uint8_t w, uint8_t r, uint8_t b>
+void testSearch(std::mt19937 &rng)
+{
+    using Search = RC5KeySearch<w, r, b>;
+    typename Search::Key key{};
+    for (auto &byte : key)
+        byte = uint8_t(rng());
+    assert((Search::setupS(key) == RC5<w, r, b>::setupS(key)));
+
+    typename Search::Block plaintext{};
+    for (auto &byte : plaintext)
+        byte = uint8_t(rng());
+    const auto ciphertext = RC5<w, r, b>::encode(key, plaintext);
+    const Search search(plaintext, ciphertext);
+    assert(search.matches(key));
+
+    // start is 1000 keys below, the range carries into the second to last byte
+    if constexpr (b > 1)
     {
-        const array<Word, t> S = setupS(K);
+        key[b - 2] |= 0x10;
+        key[b - 1] = 0x20;
+        typename Search::Key start = key;
+        start[b - 2] -= 4;
+        start[b - 1] += 24;
+        assert(Search::advance(start, 1000) == key);
+
+        const Search inRange(plaintext, RC5<w, r, b>::encode(key, plaintext));
+        const auto found = inRange.search(start, 3000);
+        assert(found.found && found.key == key && found.tried == 1001);
+        const auto missed = inRange.search(Search::advance(key, 1), 500);
+        assert(!missed.found && missed.tried == 500);
 
-        for (uint8_t i = r; i > 0; --i)
+        // one key per lane, runs of the last byte with the rest hoisted
+        const RC5KeySearchSimd<w, r, b> simd(plaintext, RC5<w, r, b>::encode(key, plaintext));
+        const auto foundSimd = simd.search(start, 3000);
+        assert(foundSimd.found && foundSimd.key == key && foundSimd.tried == 1001);
+        const auto missedSimd = simd.search(Search::advance(key, 1), 500);
+        assert(!missedSimd.found && missedSimd.tried == 500);
+
+        // the key in every lane position, near the end of a run
+        typename Search::Key late = key;
+        late[b - 1] = 0xF8;
+        const RC5KeySearchSimd<w, r, b> lateSimd(plaintext, RC5<w, r, b>::encode(late, plaintext));
+        for (unsigned offset = 0; offset <= 2 * simd.lanes && offset <= 0xF8; ++offset)
         {
-            B = right_shift(B - S[2 * i + 1], A) ^ A;
-            A = right_shift(A - S[2 * i], B) ^ B;
+            typename Search::Key from = late;
+            from[b - 1] -= offset;
+            const auto result = lateSimd.search(from, offset + 20);
+            assert(result.found && result.key == late && result.tried == offset + 1);
         }
-        B -= S[1];
-        A -= S[0];
     }
+}
+
+void test17()
+{
+    std::mt19937 rng(17);
+    testSearch<32, 12, 16>(rng);
+    testSearch<32, 12, 9>(rng);
+    testSearch<32, 0, 5>(rng);
+    testSearch<16, 12, 0>(rng);
+    testSearch<64, 20, 8>(rng);
+
+    // Rivest's vector, key found from 70000 keys below
+    constexpr std::array<uint8_t, 16> key = {0x91, 0x5F, 0x46, 0x19, 0xBE, 0x41, 0xB2, 0x51, 0x63, 0x55, 0xA5, 0x01, 0x10, 0xA9, 0xCE, 0x91};
+    constexpr std::array<uint8_t, 16> start = {0x91, 0x5F, 0x46, 0x19, 0xBE, 0x41, 0xB2, 0x51, 0x63, 0x55, 0xA5, 0x01, 0x10, 0xA8, 0xBD, 0x21};
+    constexpr std::array<uint8_t, 8> plaintext = {0x21, 0xA5, 0xDB, 0xEE, 0x15, 0x4B, 0x8F, 0x6D};
+    constexpr std::array<uint8_t, 8> ciphertext = {0xF7, 0xC0, 0x13, 0xAC, 0x5B, 0x2B, 0x89, 0x52};
+    using Search = RC5KeySearch<32, 12, 16>;
+    const auto found = Search(plaintext, ciphertext).search(start, 100000);
+    assert(found.found && found.key == key && found.tried == 70001);
+}
+
+void test18()
+{
+    using Runner = RC5SearchRunner<32, 12, 4>;
+    constexpr std::array<uint8_t, 4> key = {0x00, 0x01, 0x86, 0xA0}; // 100000
+    Runner::Job job;
+    job.plaintext = {1, 2, 3, 4, 5, 6, 7, 8};
+    job.ciphertext = RC5<32, 12, 4>::encode(key, job.plaintext);
+    job.count = 50000;
+    job.unitKeys = 1000;
+    const auto quiet = [](const Runner::Progress &) {};
 
-private:
-    // setup the S array based on the cipher's parameters and key
-    static constexpr array<Word, t> setupS(const Key &K)
+    // a journal with 20 units done and a torn last line, as after a crash
+    const std::string path = "rc5_test_search.journal";
+    std::remove(path.c_str());
+    Runner(job, path, 1);
     {
-        const uint8_t c = ceil(max<double>(b, 1) / u);
-        std::array<Word, c> L{};
-        for (int i = b - 1; i >= 0; --i)
-            L[i / u] = (L[i / u] << 8) + K[i];
-
-        array<Word, t> S{};
-        S[0] = P;
-        for (int i = 1; i < t; ++i)
-            S[i] = S[i - 1] + Q;
-
-        uint16_t i = 0, j = 0;
-        Word A = 0, B = 0;
-        for (int k = 0; k < 3 * max<uint16_t>(t, c); ++k)
-        {
-            A = S[i] = left_shift(S[i] + A + B, 3);
-            B = L[j] = left_shift(L[j] + A + B, A + B);
-            i = (i + 1) % t;
-            j = (j + 1) % c;
-        }
-        return S;
+        std::ofstream journal(path, std::ios::app);
+        for (int unit = 10; unit < 30; ++unit)
+            journal << "done " << unit << "\n";
+        journal << "done 4";
     }
+    Runner resumed(job, path, 3);
+    assert(resumed.unitsDone() == 20);
+    const auto exhausted = resumed.run(quiet);
+    assert(!exhausted.found && exhausted.complete && exhausted.keysSearched == 30000);
+    assert(Runner(job, path, 2).run(quiet).keysSearched == 0);
 
-    //////////// UTILITY FUNCTIONS
-
-    // packs bytes from the stream into a Word and returns it
-    template <typename InputStream>
-    static constexpr inline Word packWord(const InputStream &input_stream, uint16_t start)
+    // another job must not reuse the journal
+    job.count = 200000;
+    bool rejected = false;
+    try
+    {
+        Runner(job, path, 1);
+    }
+    catch (const std::invalid_argument &)
     {
-        Word word{};
-        for (auto i = 1; i <= u; ++i)
-            word = (word << 8) + input_stream[start + u - i];
-        return word;
+        rejected = true;
     }
+    assert(rejected);
 
-    // unpacks bytes from a Word and inserts them into the stream
-    template <typename OutputStream>
-    static constexpr inline void unpackWord(OutputStream &outputStream, uint16_t start, const Word &word)
+    // a range that runs past the last key is refused, one that ends on it is not
+    Runner::Job edge = job;
+    edge.start = {0xff, 0xff, 0xff, 0x00};
+    edge.count = 256;
+    assert(edge.fits());
+    edge.count = 257;
+    assert(!edge.fits());
+    edge.count = ~uint64_t(0);
+    edge.unitKeys = 1 << 20;
+    assert(edge.units() == (uint64_t(1) << 44));
+    rejected = false;
+    try
+    {
+        Runner(edge, path, 1);
+    }
+    catch (const std::invalid_argument &)
     {
-        for (auto i = 0; i < u; ++i)
-            outputStream[start + i] = (word & (0xFFull << i * 8)) >> (i * 8);
+        rejected = true;
     }
+    assert(rejected);
+    RC5SearchJob<32, 12, 16> wide;
+    wide.count = ~uint64_t(0);
+    wide.start.fill(0xff);
+    wide.start[7] = 0xfe;
+    assert(wide.fits());
+    wide.start[7] = 0xff;
+    std::fill(wide.start.begin() + 8, wide.start.end(), 0);
+    assert(wide.fits());
+    wide.start[15] = 1;
+    assert(wide.fits());
+    wide.start[15] = 2;
+    assert(!wide.fits());
+
+    std::remove(path.c_str());
+    const auto found = Runner(job, path, 4).run(quiet);
+    assert(found.found && found.key == key);
+    const auto again = Runner(job, path, 4).run(quiet);
+    assert(again.found && again.key == key && again.keysSearched == 0);
+    std::remove(path.c_str());
+}
 
-    static constexpr inline Word left_shift(const Word &x, const Word &y)
+void test19()
+{
+    using Coordinator = RC5SearchCoordinator<32, 12, 4>;
+    constexpr std::array<uint8_t, 4> key = {0x00, 0x01, 0x86, 0xA0}; // 100000
+    Coordinator::Job job;
+    job.start = {0x00, 0x01, 0x72, 0x18}; // 95000, so the key is in unit 0
+    job.plaintext = {1, 2, 3, 4, 5, 6, 7, 8};
+    job.ciphertext = RC5<32, 12, 4>::encode(key, job.plaintext);
+    job.count = 200000;
+    job.unitKeys = 10000;
+
+    const std::string path = "rc5_test_search.sock";
+    Coordinator coordinator(job, path, std::chrono::milliseconds(200));
+
+    // a worker that takes unit 0 and hangs, one that takes unit 1 and dies,
+    // one built for another key length, then two that do the work
+    std::atomic<int> stage{0};
+    std::vector<std::thread> workers;
+    workers.emplace_back([&] {
+        auto connection = RC5SearchConnection::connect(path);
+        std::string message;
+        assert(connection.receive(message) && connection.send("lease") && connection.receive(message));
+        assert(message.rfind("unit 0 00017218 10000", 0) == 0);
+        stage = 1;
+        assert(!connection.receive(message)); // dropped when the lease runs out
+    });
+    workers.emplace_back([&] {
+        while (stage < 1)
+            std::this_thread::yield();
+        auto connection = RC5SearchConnection::connect(path);
+        std::string message;
+        assert(connection.receive(message) && connection.send("lease") && connection.receive(message));
+        assert(message.rfind("unit 1 ", 0) == 0);
+        bool rejected = false;
+        try
+        {
+            RC5SearchWorker<32, 12, 8> mismatched(path);
+        }
+        catch (const std::invalid_argument &)
+        {
+            rejected = true;
+        }
+        assert(rejected);
+        stage = 2;
+    });
+    std::atomic<uint64_t> units{0};
+    for (int i = 0; i < 2; ++i)
+        workers.emplace_back([&] {
+            while (stage < 2)
+                std::this_thread::yield();
+            const auto result = RC5SearchWorker<32, 12, 4>(path).run();
+            assert(result.finished);
+            units += result.units;
+        });
+
+    const auto result = coordinator.run([](const Coordinator::Progress &) {});
+    for (std::thread &worker : workers)
+        worker.join();
+    assert(result.found && result.key == key && result.reissued == 2);
+    assert(units > 0);
+}
+
+// reduced-round statistics against block-by-block encodeWords
+template <uint8_t w, uint8_t r>
+void testDifferential()
+{
+    using Analysis = RC5Differential<w, r, 16>;
+    using Word = typename Analysis::Word;
+    using Cipher = RC5<w, r, 16>;
+    typename Analysis::Key key;
+    for (size_t i = 0; i < key.size(); ++i)
+        key[i] = uint8_t(i * 29 + 3);
+    const auto S = Cipher::setupS(key);
+
+    typename Analysis::Spec spec;
+    spec.delta = {Word(0x80000000), Word(1) << (w - 1)};
+    spec.target = {Word(0x80000000), 0};
+    spec.alpha = {Word(1), 0};
+    spec.beta = {0, Word(1)};
+    spec.wordB = true;
+    spec.shift = w - 10;
+    spec.bits = 10;
+    constexpr uint64_t samples = 10007, seed = 42;
+
+    typename Analysis::Stats expected;
+    expected.samples = samples;
+    expected.histogram.assign(1 << spec.bits, 0);
+    for (uint64_t n = 0; n < samples; ++n)
     {
-        return x << (y & (w - 1)) | x >> (w - (y & (w - 1)));
+        const auto plaintext = Analysis::plaintext(seed, n);
+        Word A = plaintext.A, B = plaintext.B;
+        Cipher::encodeWords(S, A, B);
+        Word A2 = plaintext.A ^ spec.delta.A, B2 = plaintext.B ^ spec.delta.B;
+        Cipher::encodeWords(S, A2, B2);
+        expected.hits += (A ^ A2) == spec.target.A && (B ^ B2) == spec.target.B;
+        expected.agree += (plaintext.A & 1) == (B & 1);
+        ++expected.histogram[(B ^ B2) >> spec.shift];
     }
 
-    static constexpr inline Word right_shift(const Word &x, const Word &y)
+    for (unsigned threads : {1, 3, 7})
     {
-        return x >> (y & (w - 1)) | x << (w - (y & (w - 1)));
+        const auto stats = Analysis::run(key, spec, samples, seed, threads);
+        assert(stats.samples == samples && stats.hits == expected.hits && stats.agree == expected.agree);
+        assert(stats.histogram == expected.histogram);
     }
-};
+}
 
-//////// TESTS
+void test20()
+{
+    testDifferential<32, 0>();
+    testDifferential<32, 3>();
+    testDifferential<64, 2>();
 
-// constexpr comparison for containers supporting `size()` and random indexing
-template <typename ContainerType>
-constexpr bool constexpr_compare(const ContainerType &c1, const ContainerType &c2)
+    // without rounds a difference in the top bits only passes the additions unchanged
+    typename RC5Differential<32, 0, 16>::Spec spec;
+    spec.delta = spec.target = {0x80000000, 0x80000000};
+    const auto stats = RC5Differential<32, 0, 16>::run({}, spec, 1000, 7, 2);
+    assert(stats.hits == 1000 && stats.probability() == 1 && stats.histogram[0] == 1000);
+
+    // a histogram per thread bounds the buckets
+    spec.bits = 25;
+    bool thrown = false;
+    try
+    {
+        RC5Differential<32, 0, 16>::run({}, spec, 1, 7, 1);
+    }
+    catch (const std::invalid_argument &)
+    {
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+// threaded CTR and CBC decryption against the single-threaded modes
+template <uint8_t w, uint8_t r, uint8_t b>
+void testParallel(std::mt19937 &rng)
 {
-    if (c1.size() != c2.size())
-        return false;
+    using Parallel = RC5Parallel<w, r, b>;
+    using Cipher = RC5<w, r, b>;
+    constexpr size_t blockSize = 2 * Cipher::u;
+    typename Cipher::Key key;
+    for (auto &byte : key)
+        byte = uint8_t(rng());
+    const auto S = Cipher::setupS(key);
+    typename Parallel::Block iv;
+    for (auto &byte : iv)
+        byte = uint8_t(rng());
+    iv[0] = 0xF0; // the counter carries within the first batch
 
-    for (int i = 0; i < c1.size(); ++i)
-        if (c1[i] != c2[i])
-            return false;
+    for (size_t bytes : {size_t(0), size_t(5), blockSize * 3 + 1, size_t(Parallel::minChunk * 3 + 7), size_t(Parallel::minChunk * 5 / 2)})
+    {
+        std::vector<uint8_t> plaintext(bytes), expected(bytes), actual(bytes);
+        for (auto &byte : plaintext)
+            byte = uint8_t(rng());
+        const uint64_t firstBlock = rng() % 1000;
+        RC5Ctr<w, r, b>::crypt(S, iv, firstBlock, plaintext.data(), expected.data(), bytes);
+        for (unsigned threads : {1, 3, 4})
+        {
+            Parallel::ctr(S, iv, firstBlock, plaintext.data(), actual.data(), bytes, threads);
+            assert(actual == expected);
+        }
+        actual = plaintext;
+        Parallel::ctr(S, iv, firstBlock, actual.data(), actual.data(), bytes, 2);
+        assert(actual == expected);
 
-    return true;
+        const size_t blocks = bytes / blockSize;
+        RC5Cbc<w, r, b>::encrypt(S, iv, plaintext.data(), expected.data(), blocks);
+        for (unsigned threads : {1, 3, 4})
+        {
+            std::fill(actual.begin(), actual.end(), 0);
+            Parallel::cbcDecrypt(S, iv, expected.data(), actual.data(), blocks, threads);
+            assert(std::equal(actual.begin(), actual.begin() + blocks * blockSize, plaintext.begin()));
+            actual = expected;
+            Parallel::cbcDecrypt(S, iv, actual.data(), actual.data(), blocks, threads);
+            assert(std::equal(actual.begin(), actual.begin() + blocks * blockSize, plaintext.begin()));
+        }
+    }
 }
 
-void test1()
+void test21()
 {
-    constexpr std::array<uint8_t, 16> key = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F};
-    constexpr std::array<uint8_t, 8> plaintext = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77};
-    constexpr std::array<uint8_t, 8> ciphertext = {0x2D, 0xDC, 0x14, 0x9B, 0xCF, 0x08, 0x8B, 0x9E};
+    std::mt19937 rng(21);
+    testParallel<32, 12, 16>(rng);
+    testParallel<64, 20, 8>(rng);
+    testParallel<16, 1, 0>(rng);
+}
 
-    // the following RC5 encoding is done during COMPILE time
-    constexpr auto res = RC5<32, 12, 16>::encode(key, plaintext);
-    static_assert(constexpr_compare(res, ciphertext));
+// both pipeline backends against RC5Ctr::crypt between two files, with a short
+// last chunk, more chunks than buffers and offsets on both sides
+void test22()
+{
+    using Cipher = RC5<32, 12, 16>;
+    std::mt19937 rng(22);
+    Cipher::Key key;
+    for (auto &byte : key)
+        byte = uint8_t(rng());
+    const auto S = Cipher::setupS(key);
+    const RC5Ctr<32, 12, 16>::Block iv = {1, 2, 3, 4, 5, 6, 7, 8};
 
-    // the following RC5 encoding is done during RUNTIME
-    assert((RC5<32, 12, 16>::encode(key, plaintext) == ciphertext));
+    const size_t bytes = 40 * 4096 + 13;
+    std::vector<uint8_t> plaintext(bytes + 8), expected(bytes);
+    for (auto &byte : plaintext)
+        byte = uint8_t(rng());
+    RC5Ctr<32, 12, 16>::crypt(S, iv, 0, plaintext.data() + 8, expected.data(), bytes);
+
+    const std::string inPath = "rc5_test_pipeline.in", outPath = "rc5_test_pipeline.out";
+    std::ofstream(inPath, std::ios::binary).write(reinterpret_cast<const char *>(plaintext.data()), plaintext.size());
+    const int in = open(inPath.c_str(), O_RDONLY | O_CLOEXEC);
+    assert(in >= 0);
+    const auto ctr = [&](uint8_t *data, size_t n, uint64_t offset) { RC5Parallel<32, 12, 16>::ctr(S, iv, offset / 8, data, data, n, 1); };
+
+    // the ring path must not fall back where the kernel has io_uring; where
+    // it has none (or seccomp refuses it) only the threads are checked
+    io_uring_params params{};
+    const int probe = int(syscall(__NR_io_uring_setup, 4, &params));
+    const bool haveUring = probe >= 0;
+    if (haveUring)
+        close(probe);
+
+    for (bool uring : {true, false})
+    {
+        RC5Pipeline pipeline({4096, 4, 3, uring});
+        const int out = open(outPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        assert(out >= 0);
+        const auto stats = pipeline.run(in, 8, out, 5, bytes, ctr);
+        assert(stats.bytes == bytes && stats.uring == (uring && haveUring) && stats.overlapSeconds <= std::min(stats.ioSeconds, stats.computeSeconds) + 1e-9);
+        std::vector<uint8_t> actual(bytes + 5);
+        assert(pread(out, actual.data(), actual.size(), 0) == ssize_t(actual.size()));
+        assert(std::equal(expected.begin(), expected.end(), actual.begin() + 5));
+
+        // a failing transform and a short input surface as exceptions
+        bool thrown = false;
+        try
+        {
+            pipeline.run(in, 8, out, 0, bytes, [](uint8_t *, size_t, uint64_t offset) {
+                if (offset == 8 * 4096)
+                    throw std::runtime_error("transform");
+            });
+        }
+        catch (const std::runtime_error &e)
+        {
+            thrown = std::string(e.what()) == "transform";
+        }
+        assert(thrown);
+        thrown = false;
+        try
+        {
+            pipeline.run(in, 8, out, 0, bytes + 1, ctr);
+        }
+        catch (const std::system_error &)
+        {
+            thrown = true;
+        }
+        assert(thrown);
+        close(out);
+    }
+    close(in);
+    std::remove(inPath.c_str());
+    std::remove(outPath.c_str());
 }
 
-void test2()
+// the stream between pipes fed in odd pieces, into a pipe (vmsplice) and into
+// a file (write): whole chunks but the last, which may grow by the tail
+void test23()
 {
-    constexpr std::array<uint8_t, 16> key = {0x2B, 0xD6, 0x45, 0x9F, 0x82, 0xC5, 0xB3, 0x00, 0x95, 0x2C, 0x49, 0x10, 0x48, 0x81, 0xFF, 0x48};
-    constexpr std::array<uint8_t, 8> plaintext = {0xEA, 0x02, 0x47, 0x14, 0xAD, 0x5C, 0x4D, 0x84};
-    constexpr std::array<uint8_t, 8> ciphertext = {0x11, 0xE4, 0x3B, 0x86, 0xD2, 0x31, 0xEA, 0x64};
-    constexpr auto res = RC5<32, 12, 16>::encode(key, plaintext);
-    static_assert(constexpr_compare(res, ciphertext));
+    std::mt19937 rng(23);
+    for (size_t bytes : {size_t(0), size_t(100), size_t(3 * 8192), size_t(10 * 8192 + 77), size_t(300 * 8192 + 5)})
+    {
+        std::vector<uint8_t> input(bytes);
+        for (auto &byte : input)
+            byte = uint8_t(rng());
+        for (bool toPipe : {true, false})
+        {
+            int in[2], out[2] = {-1, -1};
+            assert(pipe(in) == 0);
+            const std::string path = "rc5_test_stream.out";
+            if (toPipe)
+                assert(pipe(out) == 0);
+            else
+                out[1] = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            std::thread feeder([&] {
+                std::mt19937 pieces(bytes);
+                for (size_t done = 0; done < bytes;)
+                    done += write(in[1], input.data() + done, std::min<size_t>(bytes - done, pieces() % 10000 + 1));
+                close(in[1]);
+            });
+            std::vector<uint8_t> output;
+            std::thread drain([&] {
+                uint8_t buffer[4096];
+                for (ssize_t n; toPipe && (n = read(out[0], buffer, sizeof(buffer))) > 0;)
+                    output.insert(output.end(), buffer, buffer + n);
+            });
+
+            uint64_t position = 0;
+            bool sawLast = false;
+            RC5Stream stream({8192, 3, 3, true});
+            const auto stats = stream.run(in[0], out[1], [&](uint8_t *data, size_t n, bool last) {
+                assert(!sawLast && (last || n == 8192) && (n || !position));
+                for (size_t i = 0; i < n; ++i)
+                    data[i] ^= uint8_t(position + i);
+                position += n;
+                sawLast = last;
+                std::fill(data + n, data + n + 3, 0xEE);
+                return last ? n + 3 : n;
+            });
+            feeder.join();
+            close(out[1]);
+            drain.join();
+            if (!toPipe)
+            {
+                output.resize(bytes + 3);
+                assert(pread(out[1] = open(path.c_str(), O_RDONLY), output.data(), output.size(), 0) == ssize_t(output.size()));
+                close(out[1]);
+                std::remove(path.c_str());
+            }
+            assert(sawLast && stats.in == bytes && stats.out == bytes + 3 && stats.spliced == toPipe && output.size() == bytes + 3);
+            for (size_t i = 0; i < bytes; ++i)
+                assert(output[i] == uint8_t(input[i] ^ uint8_t(i)));
+            assert(output[bytes] == 0xEE && output[bytes + 2] == 0xEE);
+            close(in[0]);
+            if (toPipe)
+                close(out[0]);
+        }
+    }
 }
 
-void test3()
+// a sealed container read back whole and in random ranges, and refused
+// after tampering with a chunk, with the index, with the length or the key
+template <uint8_t w, uint8_t r, uint8_t b>
+void testContainer(std::mt19937 &rng)
 {
-    constexpr std::array<uint8_t, 16> key = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F};
-    constexpr std::array<uint8_t, 8> plaintext = {0x96, 0x95, 0x0D, 0xDA, 0x65, 0x4A, 0x3D, 0x62};
-    constexpr std::array<uint8_t, 8> ciphertext = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77};
-    constexpr auto res = RC5<32, 12, 16>::decode(key, ciphertext);
-    static_assert(constexpr_compare(res, plaintext));
+    using Container = RC5Container<w, r, b>;
+    constexpr size_t chunk = 8 * Container::blockSize;
+    typename Container::Key key;
+    for (auto &byte : key)
+        byte = uint8_t(rng());
+    const typename Container::Keys keys(key);
+    const std::string path = "rc5_test_container";
+
+    for (size_t bytes : {size_t(0), size_t(1), chunk - 1, chunk, 7 * chunk / 2 + 3})
+    {
+        std::vector<uint8_t> plaintext(bytes), sealed(Container::sealedSize(bytes, chunk));
+        for (auto &byte : plaintext)
+            byte = uint8_t(rng());
+        Container::seal(keys, plaintext.data(), bytes, sealed.data(), chunk, 3);
+        const auto store = [&](const std::vector<uint8_t> &contents) {
+            std::ofstream(path, std::ios::binary | std::ios::trunc).write(reinterpret_cast<const char *>(contents.data()), contents.size());
+            return open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        };
+        const auto refused = [&](const std::vector<uint8_t> &contents, const typename Container::Keys &with) {
+            const int fd = store(contents);
+            bool thrown = false;
+            try
+            {
+                typename Container::Reader(with, fd);
+            }
+            catch (const std::runtime_error &)
+            {
+                thrown = true;
+            }
+            close(fd);
+            return thrown;
+        };
+
+        // a header asking for chunks larger than any reader allocates
+        auto forged = sealed;
+        forged[12 + 3] = 0x80;
+        assert(refused(forged, keys));
+
+        int fd = store(sealed);
+        {
+            const typename Container::Reader reader(keys, fd);
+            assert(reader.size() == bytes && reader.chunkBytes() == chunk);
+            std::vector<uint8_t> actual(bytes + 5);
+            assert(reader.pread(actual.data(), actual.size(), 0, 2) == bytes);
+            assert(std::equal(plaintext.begin(), plaintext.end(), actual.begin()));
+            for (int i = 0; i < 50 && bytes; ++i)
+            {
+                const uint64_t offset = rng() % bytes;
+                const size_t n = rng() % (bytes - offset + 3);
+                std::fill(actual.begin(), actual.end(), 0);
+                const size_t got = reader.pread(actual.data(), n, offset, 1 + i % 3);
+                assert(got == std::min<uint64_t>(n, bytes - offset));
+                assert(std::equal(actual.begin(), actual.begin() + got, plaintext.begin() + offset));
+            }
+            assert(reader.pread(actual.data(), 1, bytes) == 0);
+        }
+        close(fd);
+
+        // the tampering below needs two chunks
+        if (bytes <= chunk)
+        {
+            assert(refused(sealed, typename Container::Keys(typename Container::Key{})) == (b > 0));
+            continue;
+        }
+        // a flipped ciphertext bit spoils its chunk only
+        auto tampered = sealed;
+        tampered[Container::headerSize + chunk + 1] ^= 1;
+        fd = store(tampered);
+        {
+            const typename Container::Reader reader(keys, fd);
+            std::vector<uint8_t> actual(bytes);
+            assert(reader.pread(actual.data(), chunk, 0) == chunk);
+            bool thrown = false;
+            try
+            {
+                reader.pread(actual.data(), bytes, 0, 2);
+            }
+            catch (const std::runtime_error &)
+            {
+                thrown = true;
+            }
+            assert(thrown);
+        }
+        close(fd);
+
+        // two chunks swapped, a tag changed, the file cut short
+        tampered = sealed;
+        std::swap_ranges(tampered.begin() + Container::headerSize, tampered.begin() + Container::headerSize + chunk,
+                         tampered.begin() + Container::headerSize + chunk);
+        fd = store(tampered);
+        {
+            const typename Container::Reader reader(keys, fd);
+            uint8_t byte;
+            bool thrown = false;
+            try
+            {
+                reader.pread(&byte, 1, 0);
+            }
+            catch (const std::runtime_error &)
+            {
+                thrown = true;
+            }
+            assert(thrown);
+        }
+        close(fd);
+        tampered = sealed;
+        tampered[Container::headerSize + bytes] ^= 0x80;
+        assert(refused(tampered, keys));
+        tampered = sealed;
+        tampered.erase(tampered.begin() + Container::headerSize + bytes - 1);
+        assert(refused(tampered, keys));
+    }
+
+    // counters never repeat within a file and keys differ between files, so
+    // the keystream blocks of two seals of zeros are all distinct
+    const size_t bytes = 4 * chunk;
+    std::vector<uint8_t> zeros(bytes), sealed(2 * Container::sealedSize(bytes, chunk));
+    Container::seal(keys, zeros.data(), bytes, sealed.data(), chunk, 2);
+    Container::seal(keys, zeros.data(), bytes, sealed.data() + sealed.size() / 2, chunk, 2);
+    std::set<std::vector<uint8_t>> blocks;
+    for (size_t file = 0; file < 2; ++file)
+        for (size_t at = 0; at < bytes; at += Container::blockSize)
+        {
+            const auto block = sealed.begin() + file * sealed.size() / 2 + Container::headerSize + at;
+            blocks.emplace(block, block + Container::blockSize);
+        }
+    assert(blocks.size() == 2 * bytes / Container::blockSize);
+    std::remove(path.c_str());
 }
 
-void test4()
+void test24()
 {
-    constexpr std::array<uint8_t, 16> key = {0x2B, 0xD6, 0x45, 0x9F, 0x82, 0xC5, 0xB3, 0x00, 0x95, 0x2C, 0x49, 0x10, 0x48, 0x81, 0xFF, 0x48};
-    constexpr std::array<uint8_t, 8> plaintext = {0x63, 0x8B, 0x3A, 0x5E, 0xF7, 0x2B, 0x66, 0x3F};
-    constexpr std::array<uint8_t, 8> ciphertext = {0xEA, 0x02, 0x47, 0x14, 0xAD, 0x5C, 0x4D, 0x84};
-    constexpr auto res = RC5<32, 12, 16>::decode(key, ciphertext);
-    static_assert(constexpr_compare(res, plaintext));
+    std::mt19937 rng(24);
+    testContainer<32, 12, 16>(rng);
+    testContainer<64, 16, 8>(rng);
 }
 
-// cipher with w = 64
-void test5()
+// the lazily decrypted plaintext of CTR files, touched in a scattered order
+// and from several threads at once: nothing is decrypted before it is read,
+// a window at most once, and every byte matches
+template <uint8_t w, uint8_t r, uint8_t b>
+void testLazy(std::mt19937 &rng)
 {
-    constexpr std::array<uint8_t, 24> key = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17};
-    ;
-    constexpr std::array<uint8_t, 16> plaintext = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F};
-    constexpr std::array<uint8_t, 16> ciphertext = {0xA4, 0x67, 0x72, 0x82, 0x0E, 0xDB, 0xCE, 0x02, 0x35, 0xAB, 0xEA, 0x32, 0xAE, 0x71, 0x78, 0xDA};
-    constexpr auto res = RC5<64, 24, 24>::encode(key, plaintext);
-    static_assert(constexpr_compare(res, ciphertext));
+    using Lazy = RC5LazyCtr<w, r, b>;
+    using Cipher = RC5<w, r, b>;
+    typename Cipher::Key key;
+    for (auto &byte : key)
+        byte = uint8_t(rng());
+    const auto S = Cipher::setupS(key);
+    typename Lazy::Block iv;
+    for (auto &byte : iv)
+        byte = uint8_t(rng());
+    const std::string path = "rc5_test_lazy";
+    const size_t window = 4 * 4096;
+
+    for (size_t bytes : {size_t(0), size_t(1), size_t(4095), window + 5, 10 * window + 4096 + 3})
+    {
+        // an 8-byte prefix, as in the rc5 CTR format
+        std::vector<uint8_t> plaintext(bytes), file(8 + bytes);
+        for (auto &byte : plaintext)
+            byte = uint8_t(rng());
+        RC5Parallel<w, r, b>::ctr(S, iv, 0, plaintext.data(), file.data() + 8, bytes, 2);
+        std::ofstream(path, std::ios::binary | std::ios::trunc).write(reinterpret_cast<const char *>(file.data()), file.size());
+        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        assert(fd >= 0);
+
+        std::optional<Lazy> lazy;
+        try
+        {
+            lazy.emplace(S, iv, fd, 8, bytes, typename Lazy::Options{window});
+        }
+        catch (const std::system_error &)
+        {
+            // no userfaultfd here (seccomp, or a kernel without it)
+            close(fd);
+            std::remove(path.c_str());
+            return;
+        }
+        assert(lazy->size() == bytes && lazy->faults() == 0);
+        const uint8_t *data = lazy->data();
+        if (bytes)
+        {
+            const size_t last = bytes - 1;
+            assert(data[last] == plaintext[last]);
+            assert(lazy->faults() == 1);
+            assert(data[last / window * window] == plaintext[last / window * window] && lazy->faults() == 1);
+        }
+        for (int i = 0; bytes && i < 20; ++i)
+        {
+            const size_t at = rng() % bytes;
+            assert(data[at] == plaintext[at]);
+        }
+        std::vector<std::thread> readers;
+        std::atomic<bool> same = true;
+        for (int t = 0; t < 3; ++t)
+            readers.emplace_back([&] {
+                if (!std::equal(plaintext.begin(), plaintext.end(), data))
+                    same = false;
+            });
+        for (auto &reader : readers)
+            reader.join();
+        assert(same);
+        assert(lazy->faults() == (bytes + window - 1) / window);
+        lazy->check();
+        lazy.reset();
+        close(fd);
+    }
+
+    // a file shorter than claimed reads as zeros and reports the error
+    {
+        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        Lazy lazy(S, iv, fd, 8, 12 * window, typename Lazy::Options{window});
+        assert(lazy.data()[11 * window] == 0);
+        bool thrown = false;
+        try
+        {
+            lazy.check();
+        }
+        catch (const std::system_error &)
+        {
+            thrown = true;
+        }
+        assert(thrown);
+        close(fd);
+    }
+    std::remove(path.c_str());
 }
 
-// cipher with L = 0 (result is not compared, as I found no test vectors with L = 0)
-void test6()
+void test25()
 {
-    constexpr std::array<uint8_t, 0> key = {};
-    constexpr std::array<uint8_t, 16> plaintext = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F};
-    constexpr std::array<uint8_t, 16> ciphertext = {0xA4, 0x67, 0x72, 0x82, 0x0E, 0xDB, 0xCE, 0x02, 0x35, 0xAB, 0xEA, 0x32, 0xAE, 0x71, 0x78, 0xDA};
-    RC5<64, 24, 0>::encode(key, plaintext);
+    std::mt19937 rng(25);
+    testLazy<32, 12, 16>(rng);
+    testLazy<64, 16, 8>(rng);
 }
 
 int main()
@@ -269,6 +1292,27 @@ int main()
     test4();
     test5();
     test6();
+    test7();
+    test8();
+#if defined(__x86_64__)
+    test9();
+#endif
+    test10();
+    test11();
+    test12();
+    test13();
+    test14();
+    test15();
+    test16();
+    test17();
+    test18();
+    test19();
+    test20();
+    test21();
+    test22();
+    test23();
+    test24();
+    test25();
 
     return 0;
 }
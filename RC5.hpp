@@ -0,0 +1,671 @@
+#pragma once
+
+#include <array>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// optional hardware counter hooks around key setup and bulk calls, build with
+// -DRC5_PERF to enable (see RC5Perf.hpp)
+#if defined(RC5_PERF)
+#include "RC5Perf.hpp"
+#define RC5_PERF_SCOPE(region) PerfScope perfScope(region)
+#else
+#define RC5_PERF_SCOPE(region)
+#endif
+
+// optional usage counters, build with -DRC5_METRICS to enable (see RC5Metrics.hpp)
+#if defined(RC5_METRICS)
+#include "RC5Metrics.hpp"
+// skipped while constant evaluating, so constexpr code can count as well
+#define RC5_METRIC_ADD(metric, n) (is_constant_evaluated() ? void() : metricsAdd(metric, n))
+#else
+#define RC5_METRIC_ADD(metric, n)
+#endif
+
+// USDT tracepoints around key setup and bulk calls (see RC5Probes.hpp)
+#include "RC5Probes.hpp"
+
+//////// UTILITY TEMPLATES
+
+template <uint8_t w>
+struct WordT
+{
+    // any RC5 cipher with w different from 16, 32, 64, 128 will fail to compile
+    using type = void;
+};
+
+template <>
+struct WordT<16>
+{
+    using type = uint16_t;
+    static constexpr type P = 0xb7e1;
+    static constexpr type Q = 0x9e37;
+};
+
+template <>
+struct WordT<32>
+{
+    using type = uint32_t;
+    static constexpr type P = 0xb7e15163;
+    static constexpr type Q = 0x9e3779b9;
+};
+
+template <>
+struct WordT<64>
+{
+    using type = uint64_t;
+    static constexpr type P = 0xb7e151628aed2a6b;
+    static constexpr type Q = 0x9e3779b97f4a7c15;
+};
+
+// 256-bit blocks, relies on the GCC/Clang unsigned __int128 extension
+template <>
+struct WordT<128>
+{
+    using type = unsigned __int128;
+    static constexpr type P = type(0xb7e151628aed2a6a) << 64 | 0xbf7158809cf4f3c7;
+    static constexpr type Q = type(0x9e3779b97f4a7c15) << 64 | 0xf39cc0605cedc835;
+};
+
+//////// RC5 cipher
+
+template <uint8_t w, uint8_t r, uint8_t b>
+class RC5
+{
+    // there is no need to check the cipher parameters with static_assert, as
+    // the template construction/data types will make sure that
+    // 0 <= r <= 255 (enforced by data type)
+    // 0 <= b <= 255 (enforced by data type)
+    // w can only be 16, 32, 64, 128 (enforced by WordT template)
+    // K has exactly b bytes (enforced by Key data type)
+
+public:
+    // set the underlying type for word based on w
+    using Word = typename WordT<w>::type;
+    using Key = array<uint8_t, b>;
+
+    // constants derived from cipher's parameters
+    static constexpr uint8_t u = ceil(w / 8);
+    static constexpr uint16_t t = 2 * (r + 1);
+
+    // expanded key table
+    using Schedule = array<Word, t>;
+
+private:
+    // set magic numbers based on w
+    static constexpr Word P = WordT<w>::P;
+    static constexpr Word Q = WordT<w>::Q;
+
+public:
+
+    template <typename ByteStream>
+    static constexpr ByteStream encode(const Key &K, const ByteStream &plaintext)
+    {
+        // checking if padding on plaintext is correct
+        static_assert(ByteStream{}.size() == u * 2);
+
+        ByteStream ciphertext{};
+        Word A = packWord(plaintext, 0);
+        Word B = packWord(plaintext, u);
+        encodeWords(K, A, B);
+        unpackWord(ciphertext, 0, A);
+        unpackWord(ciphertext, u, B);
+
+        return ciphertext;
+    }
+
+    static constexpr void encodeWords(const Key& K, Word &A, Word &B)
+    {
+        encodeWords(setupS(K), A, B);
+    }
+
+    static constexpr void encodeWords(const Schedule &S, Word &A, Word &B)
+    {
+        A += S[0];
+        B += S[1];
+
+        for (unsigned i = 1; i <= r; ++i)
+        {
+            A = left_shift(A ^ B, B) + S[2 * i];
+            B = left_shift(B ^ A, A) + S[2 * i + 1];
+        }
+    }
+
+    template <typename ByteStream>
+    static constexpr ByteStream decode(const Key& K, const ByteStream &ciphertext)
+    {
+        // checking if padding on ciphertext is correct
+        static_assert(ByteStream{}.size() == u * 2);
+
+        ByteStream plaintext{};
+        Word A = packWord(ciphertext, 0);
+        Word B = packWord(ciphertext, u);
+        decodeWords(K, A, B);
+        unpackWord(plaintext, 0, A);
+        unpackWord(plaintext, u, B);
+
+        return plaintext;
+    }
+
+    static constexpr void decodeWords(const Key& K, Word &A, Word &B)
+    {
+        decodeWords(setupS(K), A, B);
+    }
+
+    static constexpr void decodeWords(const Schedule &S, Word &A, Word &B)
+    {
+        for (unsigned i = r; i > 0; --i)
+        {
+            B = right_shift(B - S[2 * i + 1], A) ^ A;
+            A = right_shift(A - S[2 * i], B) ^ B;
+        }
+        B -= S[1];
+        A -= S[0];
+    }
+
+    // encodes consecutive 2u-byte blocks (ECB) with an already expanded key,
+    // in and out may alias
+    static constexpr void encodeBlocks(const Schedule &S, const uint8_t *in, uint8_t *out, size_t blocks)
+    {
+        for (size_t k = 0; k < blocks; ++k, in += 2 * u, out += 2 * u)
+        {
+            Word A = packWord(in, 0);
+            Word B = packWord(in, u);
+            encodeWords(S, A, B);
+            unpackWord(out, 0, A);
+            unpackWord(out, u, B);
+        }
+    }
+
+    static constexpr void decodeBlocks(const Schedule &S, const uint8_t *in, uint8_t *out, size_t blocks)
+    {
+        for (size_t k = 0; k < blocks; ++k, in += 2 * u, out += 2 * u)
+        {
+            Word A = packWord(in, 0);
+            Word B = packWord(in, u);
+            decodeWords(S, A, B);
+            unpackWord(out, 0, A);
+            unpackWord(out, u, B);
+        }
+    }
+
+    // whole arrays (ECB, N a multiple of the block size) for constant
+    // evaluation: the key is expanded once, not once per block as with encode.
+    // Arrays too large for one constant expression go through RC5Fixed::encodedBlob
+    template <size_t N>
+    static constexpr array<uint8_t, N> encodeArray(const Key &K, const array<uint8_t, N> &plaintext)
+    {
+        static_assert(N % (2 * u) == 0);
+
+        array<uint8_t, N> ciphertext{};
+        encodeBlocks(setupS(K), plaintext.data(), ciphertext.data(), N / (2 * u));
+        return ciphertext;
+    }
+
+    template <size_t N>
+    static constexpr array<uint8_t, N> decodeArray(const Key &K, const array<uint8_t, N> &ciphertext)
+    {
+        static_assert(N % (2 * u) == 0);
+
+        array<uint8_t, N> plaintext{};
+        decodeBlocks(setupS(K), ciphertext.data(), plaintext.data(), N / (2 * u));
+        return plaintext;
+    }
+
+    // setup the S array based on the cipher's parameters and key
+    static constexpr Schedule setupS(const Key &K)
+    {
+        const uint8_t c = ceil(max<double>(b, 1) / u);
+        std::array<Word, c> L{};
+        for (int i = b - 1; i >= 0; --i)
+            L[i / u] = (L[i / u] << 8) + K[i];
+
+        Schedule S{};
+        S[0] = P;
+        for (int i = 1; i < t; ++i)
+            S[i] = S[i - 1] + Q;
+
+        uint16_t i = 0, j = 0;
+        Word A = 0, B = 0;
+        for (int k = 0; k < 3 * max<uint16_t>(t, c); ++k)
+        {
+            A = S[i] = left_shift(S[i] + A + B, 3);
+            B = L[j] = left_shift(L[j] + A + B, A + B);
+            i = (i + 1) % t;
+            j = (j + 1) % c;
+        }
+        return S;
+    }
+
+    //////////// UTILITY FUNCTIONS
+
+    // packs bytes from the stream into a Word and returns it
+    template <typename InputStream>
+    static constexpr inline Word packWord(const InputStream &input_stream, uint16_t start)
+    {
+        return packBytes(input_stream, start, make_index_sequence<u>{});
+    }
+
+    // unpacks bytes from a Word and inserts them into the stream
+    template <typename OutputStream>
+    static constexpr inline void unpackWord(OutputStream &outputStream, uint16_t start, const Word &word)
+    {
+        unpackBytes(outputStream, start, word, make_index_sequence<u>{});
+    }
+
+    // rotations; the complementary shift is masked as well, so a rotation by 0
+    // never shifts by w (which is undefined behaviour and not a constant expression)
+    static constexpr inline Word left_shift(const Word &x, const Word &y)
+    {
+        return x << (y & (w - 1)) | x >> ((w - (y & (w - 1))) & (w - 1));
+    }
+
+    static constexpr inline Word right_shift(const Word &x, const Word &y)
+    {
+        return x >> (y & (w - 1)) | x << ((w - (y & (w - 1))) & (w - 1));
+    }
+
+private:
+    // byte I of the word is byte start + I of the stream (little-endian); folds
+    // instead of loops, which is the same code at runtime but saves the loop
+    // bookkeeping when encrypting whole arrays during constant evaluation
+    template <typename InputStream, size_t... I>
+    static constexpr inline Word packBytes(const InputStream &input_stream, uint16_t start, index_sequence<I...>)
+    {
+        return Word(((Word(input_stream[start + I]) << (8 * I)) | ...));
+    }
+
+    template <typename OutputStream, size_t... I>
+    static constexpr inline void unpackBytes(OutputStream &outputStream, uint16_t start, const Word &word, index_sequence<I...>)
+    {
+        ((outputStream[start + I] = uint8_t(word >> (8 * I))), ...);
+    }
+};
+
+// ciphertext produced by RC5Fixed::encodedBlob: count chunks of chunkBytes
+// bytes back to back, the last one zero filled past N
+template <size_t chunkBytes, size_t count, size_t N>
+struct RC5Blob
+{
+    array<array<uint8_t, chunkBytes>, count> chunks;
+
+    static constexpr size_t size() { return N; }
+
+    constexpr uint8_t operator[](size_t i) const { return chunks[i / chunkBytes][i % chunkBytes]; }
+
+    // all N bytes, contiguous
+    const uint8_t *data() const
+    {
+        static_assert(sizeof(chunks) == chunkBytes * count);
+        return reinterpret_cast<const uint8_t *>(chunks.data());
+    }
+};
+
+//////// RC5 cipher with a key fixed at compile time
+
+// K is a non-type template parameter (an array<uint8_t, b>), so the whole S
+// table is computed during compilation and the rounds below are fully unrolled
+// with every S[i] folded into the instruction stream as an immediate
+template <uint8_t w, uint8_t r, auto K>
+class RC5Fixed
+{
+private:
+    using Cipher = RC5<w, r, K.size()>;
+
+public:
+    using Word = typename Cipher::Word;
+
+    static constexpr uint8_t u = Cipher::u;
+    static constexpr typename Cipher::Schedule S = Cipher::setupS(K);
+
+    template <typename ByteStream>
+    static constexpr ByteStream encode(const ByteStream &plaintext)
+    {
+        static_assert(ByteStream{}.size() == u * 2);
+
+        ByteStream ciphertext{};
+        Word A = Cipher::packWord(plaintext, 0);
+        Word B = Cipher::packWord(plaintext, u);
+        encodeWords(A, B);
+        Cipher::unpackWord(ciphertext, 0, A);
+        Cipher::unpackWord(ciphertext, u, B);
+
+        return ciphertext;
+    }
+
+    static constexpr inline void encodeWords(Word &A, Word &B)
+    {
+        A += S[0];
+        B += S[1];
+        encodeRounds(A, B, make_index_sequence<r>{});
+    }
+
+    template <typename ByteStream>
+    static constexpr ByteStream decode(const ByteStream &ciphertext)
+    {
+        static_assert(ByteStream{}.size() == u * 2);
+
+        ByteStream plaintext{};
+        Word A = Cipher::packWord(ciphertext, 0);
+        Word B = Cipher::packWord(ciphertext, u);
+        decodeWords(A, B);
+        Cipher::unpackWord(plaintext, 0, A);
+        Cipher::unpackWord(plaintext, u, B);
+
+        return plaintext;
+    }
+
+    static constexpr inline void decodeWords(Word &A, Word &B)
+    {
+        decodeRounds(A, B, make_index_sequence<r>{});
+        B -= S[1];
+        A -= S[0];
+    }
+
+    // same contract as RC5::encodeBlocks
+    static constexpr void encodeBlocks(const uint8_t *in, uint8_t *out, size_t blocks)
+    {
+        for (size_t k = 0; k < blocks; ++k, in += 2 * u, out += 2 * u)
+        {
+            Word A = Cipher::packWord(in, 0);
+            Word B = Cipher::packWord(in, u);
+            encodeWords(A, B);
+            Cipher::unpackWord(out, 0, A);
+            Cipher::unpackWord(out, u, B);
+        }
+    }
+
+    static constexpr void decodeBlocks(const uint8_t *in, uint8_t *out, size_t blocks)
+    {
+        for (size_t k = 0; k < blocks; ++k, in += 2 * u, out += 2 * u)
+        {
+            Word A = Cipher::packWord(in, 0);
+            Word B = Cipher::packWord(in, u);
+            decodeWords(A, B);
+            Cipher::unpackWord(out, 0, A);
+            Cipher::unpackWord(out, u, B);
+        }
+    }
+
+    template <size_t N>
+    static constexpr array<uint8_t, N> encodeArray(const array<uint8_t, N> &plaintext)
+    {
+        static_assert(N % (2 * u) == 0);
+
+        array<uint8_t, N> ciphertext{};
+        encodeBlocks(plaintext.data(), ciphertext.data(), N / (2 * u));
+        return ciphertext;
+    }
+
+    template <size_t N>
+    static constexpr array<uint8_t, N> decodeArray(const array<uint8_t, N> &ciphertext)
+    {
+        static_assert(N % (2 * u) == 0);
+
+        array<uint8_t, N> plaintext{};
+        decodeBlocks(ciphertext.data(), plaintext.data(), N / (2 * u));
+        return plaintext;
+    }
+
+    // GCC caps every constant expression at -fconstexpr-ops-limit (2^25 by
+    // default), which a single encodeArray call reaches at about 100 KiB.
+    // encodedBlob works in chunks of blobChunkBlocks blocks, which stay well
+    // below that limit for any r
+    static constexpr size_t blobChunkBlocks = max<size_t>(1, (size_t(1) << 22) / (150 * (r + 1) + 300));
+    static constexpr size_t blobChunkBytes = blobChunkBlocks * 2 * u;
+
+private:
+    template <const auto &plaintext, size_t I>
+    static constexpr auto encodeChunk()
+    {
+        constexpr size_t blocks = plaintext.size() / (2 * u);
+        constexpr size_t first = I * blobChunkBlocks;
+
+        array<uint8_t, blobChunkBytes> chunk{};
+        encodeBlocks(plaintext.data() + first * 2 * u, chunk.data(), min(blobChunkBlocks, blocks - first));
+        return chunk;
+    }
+
+    // each chunk is a variable of its own, so it is a separate constant
+    // expression with its own ops budget
+    template <const auto &plaintext, size_t I>
+    static constexpr auto blobChunk = encodeChunk<plaintext, I>();
+
+    // the chunks are copied as whole arrays; copying the bytes one by one
+    // would cost as much as encrypting them
+    template <const auto &plaintext, size_t... I>
+    static constexpr auto assembleBlob(index_sequence<I...>)
+    {
+        return RC5Blob<blobChunkBytes, sizeof...(I), plaintext.size()>{{blobChunk<plaintext, I>...}};
+    }
+
+public:
+    // the ECB encryption of a constexpr array<uint8_t, N> with static storage
+    // duration, N a multiple of the block size. It is computed during
+    // compilation, one chunk at a time, so its size is not bounded by the ops
+    // limit of a single constant expression
+    template <const auto &plaintext>
+    static constexpr auto encodedBlob = assembleBlob<plaintext>(
+        make_index_sequence<(plaintext.size() / (2 * u) + blobChunkBlocks - 1) / blobChunkBlocks>{});
+
+private:
+    // round I uses S[2I + 2] and S[2I + 3]; the fold expressions expand to r
+    // straight-line rounds with no loop counter and no table loads
+    template <size_t... I>
+    static constexpr inline void encodeRounds(Word &A, Word &B, index_sequence<I...>)
+    {
+        ((A = Cipher::left_shift(A ^ B, B) + S[2 * I + 2],
+          B = Cipher::left_shift(B ^ A, A) + S[2 * I + 3]), ...);
+    }
+
+    template <size_t... I>
+    static constexpr inline void decodeRounds(Word &A, Word &B, index_sequence<I...>)
+    {
+        ((B = Cipher::right_shift(B - S[2 * (r - I) + 1], A) ^ A,
+          A = Cipher::right_shift(A - S[2 * (r - I)], B) ^ B), ...);
+    }
+};
+
+//////// RC5 cipher with parameters chosen at runtime
+
+// generic engine for configurations that have no pre-instantiated kernel:
+// w still selects the word type, but r and b are plain runtime values
+template <uint8_t w>
+struct RC5Engine
+{
+    // r and b do not affect the word helpers, any instantiation will do
+    using Ops = RC5<w, 0, 0>;
+    using Word = typename Ops::Word;
+
+    static constexpr uint8_t u = Ops::u;
+
+    // same algorithm as RC5::setupS, S must have room for 2 * (r + 1) words
+    static void setupS(const uint8_t *K, uint8_t b, uint8_t r, Word *S)
+    {
+        const uint16_t t = 2 * (r + 1);
+        const uint16_t c = max<uint16_t>((b + u - 1) / u, 1);
+        array<Word, (255 + u - 1) / u> L{};
+        for (int i = b - 1; i >= 0; --i)
+            L[i / u] = (L[i / u] << 8) + K[i];
+
+        S[0] = WordT<w>::P;
+        for (int i = 1; i < t; ++i)
+            S[i] = S[i - 1] + WordT<w>::Q;
+
+        uint16_t i = 0, j = 0;
+        Word A = 0, B = 0;
+        for (int k = 0; k < 3 * max<uint16_t>(t, c); ++k)
+        {
+            A = S[i] = Ops::left_shift(S[i] + A + B, 3);
+            B = L[j] = Ops::left_shift(L[j] + A + B, A + B);
+            i = (i + 1) % t;
+            j = (j + 1) % c;
+        }
+    }
+
+    static void encodeBlocks(const Word *S, uint8_t r, const uint8_t *in, uint8_t *out, size_t blocks)
+    {
+        for (size_t k = 0; k < blocks; ++k, in += 2 * u, out += 2 * u)
+        {
+            Word A = Ops::packWord(in, 0) + S[0];
+            Word B = Ops::packWord(in, u) + S[1];
+            for (unsigned i = 1; i <= r; ++i)
+            {
+                A = Ops::left_shift(A ^ B, B) + S[2 * i];
+                B = Ops::left_shift(B ^ A, A) + S[2 * i + 1];
+            }
+            Ops::unpackWord(out, 0, A);
+            Ops::unpackWord(out, u, B);
+        }
+    }
+
+    static void decodeBlocks(const Word *S, uint8_t r, const uint8_t *in, uint8_t *out, size_t blocks)
+    {
+        for (size_t k = 0; k < blocks; ++k, in += 2 * u, out += 2 * u)
+        {
+            Word A = Ops::packWord(in, 0);
+            Word B = Ops::packWord(in, u);
+            for (unsigned i = r; i > 0; --i)
+            {
+                B = Ops::right_shift(B - S[2 * i + 1], A) ^ A;
+                A = Ops::right_shift(A - S[2 * i], B) ^ B;
+            }
+            Ops::unpackWord(out, 0, A - S[0]);
+            Ops::unpackWord(out, u, B - S[1]);
+        }
+    }
+};
+
+// facade for w/r/b taken from configuration: the kernel is picked once, at
+// construction, and every call then processes a whole batch of blocks
+class RC5Cipher
+{
+public:
+    RC5Cipher(uint8_t w, uint8_t r, const uint8_t *K, uint8_t b)
+        : w_(w), r_(r)
+    {
+        RC5_PERF_SCOPE(PerfKeySetup);
+        RC5_METRIC_ADD(MetricKeysExpanded, 1);
+        RC5_PROBE3(key_setup_start, w, r, b);
+        switch (w)
+        {
+        case 16: bind<16>(K, b); break;
+        case 32: bind<32>(K, b); break;
+        case 64: bind<64>(K, b); break;
+        case 128: bind<128>(K, b); break;
+        default: throw invalid_argument("RC5Cipher: w must be 16, 32, 64 or 128");
+        }
+        RC5_PROBE3(key_setup_done, w, r, b);
+    }
+
+    // in and out hold blocks * blockSize() bytes and may alias
+    void encode(const uint8_t *in, uint8_t *out, size_t blocks) const
+    {
+        RC5_PERF_SCOPE(PerfEncode);
+        RC5_METRIC_ADD(MetricBlocksEncrypted, blocks);
+        RC5_METRIC_ADD(MetricBytesEcb, blocks * blockSize());
+        RC5_PROBE4(encode_entry, blocks * blockSize(), w_, r_, specialized_);
+        encodeKernel_(S_.data(), r_, in, out, blocks);
+        RC5_PROBE4(encode_return, blocks * blockSize(), w_, r_, specialized_);
+    }
+
+    void decode(const uint8_t *in, uint8_t *out, size_t blocks) const
+    {
+        RC5_PERF_SCOPE(PerfDecode);
+        RC5_METRIC_ADD(MetricBlocksDecrypted, blocks);
+        RC5_METRIC_ADD(MetricBytesEcb, blocks * blockSize());
+        RC5_PROBE4(decode_entry, blocks * blockSize(), w_, r_, specialized_);
+        decodeKernel_(S_.data(), r_, in, out, blocks);
+        RC5_PROBE4(decode_return, blocks * blockSize(), w_, r_, specialized_);
+    }
+
+    size_t blockSize() const { return w_ / 4; }
+    uint8_t wordSize() const { return w_; }
+    uint8_t rounds() const { return r_; }
+
+    // true if a pre-instantiated kernel was found for (w, r)
+    bool specialized() const { return specialized_; }
+
+private:
+    using Kernel = void (*)(const void *S, uint8_t r, const uint8_t *in, uint8_t *out, size_t blocks);
+
+    struct KernelEntry
+    {
+        uint8_t r;
+        Kernel encode, decode;
+    };
+
+    // b only affects key setup, so the compiled kernels are keyed on (w, r)
+    template <uint8_t w, uint8_t r>
+    static void encodeKernel(const void *S, uint8_t, const uint8_t *in, uint8_t *out, size_t blocks)
+    {
+        RC5<w, r, 0>::encodeBlocks(*static_cast<const typename RC5<w, r, 0>::Schedule *>(S), in, out, blocks);
+    }
+
+    template <uint8_t w, uint8_t r>
+    static void decodeKernel(const void *S, uint8_t, const uint8_t *in, uint8_t *out, size_t blocks)
+    {
+        RC5<w, r, 0>::decodeBlocks(*static_cast<const typename RC5<w, r, 0>::Schedule *>(S), in, out, blocks);
+    }
+
+    template <uint8_t w>
+    static void genericEncodeKernel(const void *S, uint8_t r, const uint8_t *in, uint8_t *out, size_t blocks)
+    {
+        RC5Engine<w>::encodeBlocks(static_cast<const typename RC5Engine<w>::Word *>(S), r, in, out, blocks);
+    }
+
+    template <uint8_t w>
+    static void genericDecodeKernel(const void *S, uint8_t r, const uint8_t *in, uint8_t *out, size_t blocks)
+    {
+        RC5Engine<w>::decodeBlocks(static_cast<const typename RC5Engine<w>::Word *>(S), r, in, out, blocks);
+    }
+
+    template <uint8_t w, uint8_t... r>
+    static constexpr array<KernelEntry, sizeof...(r)> kernelsFor()
+    {
+        return {KernelEntry{r, encodeKernel<w, r>, decodeKernel<w, r>}...};
+    }
+
+    template <uint8_t w>
+    void bind(const uint8_t *K, uint8_t b)
+    {
+        using Word = typename RC5Engine<w>::Word;
+        const size_t t = 2 * (r_ + 1);
+        S_.assign((t * sizeof(Word) + sizeof(ScheduleSlot) - 1) / sizeof(ScheduleSlot), ScheduleSlot{});
+        RC5Engine<w>::setupS(K, b, r_, reinterpret_cast<Word *>(S_.data()));
+
+        // the round counts worth compiling ahead of time for every w
+        static constexpr auto kernels = kernelsFor<w, 8, 12, 16, 20, 24>();
+
+        encodeKernel_ = genericEncodeKernel<w>;
+        decodeKernel_ = genericDecodeKernel<w>;
+        specialized_ = false;
+        for (const auto &entry : kernels)
+            if (entry.r == r_)
+            {
+                encodeKernel_ = entry.encode;
+                decodeKernel_ = entry.decode;
+                specialized_ = true;
+            }
+    }
+
+    // raw storage for the expanded key, aligned for the widest word
+    struct alignas(alignof(WordT<128>::type)) ScheduleSlot
+    {
+        uint8_t bytes[sizeof(WordT<128>::type)];
+    };
+
+    uint8_t w_, r_;
+    vector<ScheduleSlot> S_;
+    Kernel encodeKernel_, decodeKernel_;
+    bool specialized_;
+};
@@ -0,0 +1,193 @@
+#pragma once
+
+#include "RC5Simd.hpp"
+
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+//////// REDUCED-ROUND DIFFERENTIAL AND LINEAR STATISTICS
+
+// encrypts pairs of plaintexts P and P ^ delta under one key of RC5-w/r/b,
+// meant for small r, and counts
+//   - the output differences C ^ C', as a histogram over `bits` bits of one
+//     ciphertext word from bit `shift` on
+//   - how often C ^ C' is exactly target, the probability of the differential
+//   - how often parity(P & alpha) == parity(C & beta), the linear approximation
+// Plaintexts are splitmix64 of the sample number and the seed, so a run is
+// reproducible and independent of the thread count. Every thread takes a
+// contiguous range of samples, encrypts native_simd<Word>::size() pairs per
+// iteration and counts into its own Stats; they are merged at the end
+template <uint8_t w, uint8_t r, uint8_t b>
+class RC5Differential
+{
+    // a block from one or two splitmix64 outputs
+    static_assert(w == 32 || w == 64);
+
+private:
+    using Cipher = RC5<w, r, b>;
+    using Simd = RC5Simd<w, r, b>;
+
+public:
+    using Word = typename Cipher::Word;
+    using Key = typename Cipher::Key;
+    using Schedule = typename Cipher::Schedule;
+    using Vector = typename Simd::Vector;
+
+    // pairs per vector iteration
+    static constexpr size_t lanes = Vector::size();
+
+    // a block as its two words, A first
+    struct Words
+    {
+        Word A = 0, B = 0;
+    };
+
+    struct Spec
+    {
+        Words delta;       // input difference
+        Words target;      // output difference counted exactly
+        Words alpha, beta; // plaintext and ciphertext masks of the linear approximation
+        bool wordB = false; // histogram over the B word of the difference instead of A
+        unsigned shift = 0;
+        unsigned bits = 16;
+    };
+
+    struct Stats
+    {
+        uint64_t samples = 0;
+        uint64_t hits = 0;  // output difference == target
+        uint64_t agree = 0; // parity(P & alpha) == parity(C & beta)
+        vector<uint64_t> histogram;
+
+        double probability() const
+        {
+            return samples ? double(hits) / samples : 0;
+        }
+
+        // of the linear approximation, agree / samples - 1/2
+        double bias() const
+        {
+            return samples ? double(agree) / samples - 0.5 : 0;
+        }
+
+        void merge(const Stats &other)
+        {
+            samples += other.samples;
+            hits += other.hits;
+            agree += other.agree;
+            histogram.resize(max(histogram.size(), other.histogram.size()));
+            for (size_t i = 0; i < other.histogram.size(); ++i)
+                histogram[i] += other.histogram[i];
+        }
+    };
+
+    // samples first to first + count - 1; throws invalid_argument if the
+    // histogram does not fit in a word or has more than 2^24 buckets, since
+    // every thread keeps one of its own (128 MiB each at 2^24)
+    static Stats run(const Key &key, const Spec &spec, uint64_t count, uint64_t seed, unsigned threads = thread::hardware_concurrency(),
+                     uint64_t first = 0)
+    {
+        if (spec.bits > 24 || spec.shift + spec.bits > w)
+            throw invalid_argument("RC5Differential: histogram bits out of range");
+        const Schedule S = Cipher::setupS(key);
+        threads = max(1u, threads);
+
+        vector<Stats> partial(threads);
+        vector<thread> workers;
+        // count / threads each and one more for the first count % threads,
+        // which cannot overflow for any count
+        const auto begin = [&](unsigned i) { return first + count / threads * i + min<uint64_t>(i, count % threads); };
+        for (unsigned i = 0; i < threads; ++i)
+            workers.emplace_back([&, i] { partial[i] = sample(S, spec, begin(i), begin(i + 1), seed); });
+        for (thread &worker : workers)
+            worker.join();
+
+        Stats total;
+        for (const Stats &stats : partial)
+            total.merge(stats);
+        return total;
+    }
+
+    // the first plaintext of sample n
+    static Words plaintext(uint64_t seed, uint64_t n)
+    {
+        if constexpr (w == 32)
+        {
+            const uint64_t x = splitmix(seed, n);
+            return {Word(x), Word(x >> 32)};
+        }
+        else
+        {
+            return {splitmix(seed, 2 * n), splitmix(seed, 2 * n + 1)};
+        }
+    }
+
+private:
+    static uint64_t splitmix(uint64_t seed, uint64_t n)
+    {
+        uint64_t z = seed + (n + 1) * 0x9E3779B97F4A7C15ull;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    static Stats sample(const Schedule &S, const Spec &spec, uint64_t begin, uint64_t end, uint64_t seed)
+    {
+        Stats stats;
+        stats.samples = end - begin;
+        stats.histogram.assign(size_t(1) << spec.bits, 0);
+        const Word mask = Word((uint64_t(1) << spec.bits) - 1);
+        const Vector laneIndex([](auto lane) { return Word(lane); });
+
+        for (uint64_t n = begin; n < end; n += lanes)
+        {
+            const size_t active = min<uint64_t>(lanes, end - n);
+            alignas(64) array<Word, lanes> plainA, plainB;
+            for (size_t lane = 0; lane < lanes; ++lane)
+            {
+                const Words block = plaintext(seed, n + lane);
+                plainA[lane] = block.A;
+                plainB[lane] = block.B;
+            }
+            const Vector A(plainA.data(), stdx::element_aligned), B(plainB.data(), stdx::element_aligned);
+
+            Vector CA = A, CB = B;
+            encrypt(S, CA, CB);
+            Vector DA = A ^ spec.delta.A, DB = B ^ spec.delta.B;
+            encrypt(S, DA, DB);
+            DA ^= CA;
+            DB ^= CB;
+
+            // the last iteration may run past end
+            const auto valid = laneIndex < Word(active);
+            stats.hits += stdx::popcount(valid && DA == spec.target.A && DB == spec.target.B);
+            const Vector linear = (A & spec.alpha.A) ^ (B & spec.alpha.B) ^ (CA & spec.beta.A) ^ (CB & spec.beta.B);
+            stats.agree += stdx::popcount(valid && parity(linear) == 0);
+
+            const Vector index = ((spec.wordB ? DB : DA) >> int(spec.shift)) & mask;
+            for (size_t lane = 0; lane < active; ++lane)
+                ++stats.histogram[index[lane]];
+        }
+        return stats;
+    }
+
+    static inline void encrypt(const Schedule &S, Vector &A, Vector &B)
+    {
+        A += S[0];
+        B += S[1];
+        for (unsigned i = 1; i <= r; ++i)
+        {
+            A = Simd::left_shift(A ^ B, B) + S[2 * i];
+            B = Simd::left_shift(B ^ A, A) + S[2 * i + 1];
+        }
+    }
+
+    // 0 or 1 in every lane
+    static inline Vector parity(Vector x)
+    {
+        for (unsigned s = w / 2; s > 0; s /= 2)
+            x ^= x >> int(s);
+        return x & Word(1);
+    }
+};
@@ -0,0 +1,494 @@
+#pragma once
+
+#include "RC5Parallel.hpp"
+#include "RC5Simd.hpp"
+
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <sys/random.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//////// SEEKABLE CHUNKED CONTAINER
+
+// an encrypted and authenticated file that can be read at any offset. The
+// plaintext is cut into chunks of chunkBytes (the last one shorter), and each
+// chunk is encrypted in CTR mode from its own stretch of counters and
+// authenticated by its own CMAC tag, so a byte range costs only the chunks
+// that cover it and
+// chunks are sealed and opened independently, on as many threads as given.
+// CMAC is sequential within a message, so a thread computes the tags of
+// RC5Simd::lanes chunks at once, one per vector lane.
+// The layout, integers little-endian:
+//   header  "RC5CHNK1", w, r, b, 0, chunkBytes (u32), a random 16-byte nonce
+//   chunks  the ciphertext of every chunk, back to back
+//   index   the tag of every chunk, 2u bytes each
+//   footer  plaintext size (u64), the tag of the index, "RC5CIDX1"
+// Chunk k counts from block k * chunkBytes / 2u, so counters never repeat
+// within a file, and every file has a cipher key of its own, derived from the
+// one given and the nonce: a 64-bit block is too small for random ivs under a
+// key shared by all files. A chunk's tag covers the nonce, its number, its
+// length and its ciphertext, so chunks cannot be moved within a file or
+// between files; the index tag covers header, index and size, so the file
+// cannot be cut short. The MAC key is derived from the one given as well
+template <uint8_t w, uint8_t r, uint8_t b>
+class RC5Container
+{
+    // CMAC needs the reduction polynomial of the block size: 64 or 128 bits
+    static_assert(w == 32 || w == 64);
+
+private:
+    using Cipher = RC5<w, r, b>;
+    using Parallel = RC5Parallel<w, r, b>;
+    using Simd = RC5Simd<w, r, b>;
+    using Word = typename Cipher::Word;
+    using Vector = typename Simd::Vector;
+
+public:
+    using Key = typename Cipher::Key;
+    using Schedule = typename Cipher::Schedule;
+    using Block = typename Parallel::Block;
+
+    static constexpr uint8_t u = Cipher::u;
+    static constexpr size_t blockSize = 2 * u;
+    static constexpr size_t nonceSize = 16;
+    static constexpr size_t headerSize = 16 + nonceSize;
+    static constexpr size_t entrySize = blockSize; // the tag
+    static constexpr size_t footerSize = 8 + blockSize + 8;
+    static constexpr size_t defaultChunk = 1 << 16;
+    // a bound on what a reader allocates for a header it has not yet
+    // authenticated
+    static constexpr size_t maxChunk = 1 << 24;
+
+    // the MAC key and its CMAC subkeys, and what the cipher key of each file
+    // is derived from
+    struct Keys
+    {
+        Schedule master, mac;
+        Block k1, k2;
+
+        explicit Keys(const Key &key) : master(Cipher::setupS(key))
+        {
+            const uint8_t none[nonceSize] = {};
+            mac = Cipher::setupS(derive(master, 2, none));
+            Block L{};
+            Cipher::encodeBlocks(mac, L.data(), L.data(), 1);
+            k1 = twice(L);
+            k2 = twice(k1);
+        }
+
+        // the cipher key of the file with this nonce
+        Schedule cipher(const uint8_t *nonce) const
+        {
+            return Cipher::setupS(derive(master, 1, nonce));
+        }
+
+    private:
+        // b bytes of the CBC-MAC under master of (label, i) and the nonce for
+        // i = 0, 1, ...; every message has the same length, which is what
+        // makes CBC-MAC a pseudorandom function
+        static Key derive(const Schedule &master, uint8_t label, const uint8_t *nonce)
+        {
+            Key key;
+            for (size_t i = 0; i < key.size(); i += blockSize)
+            {
+                Block block{label, uint8_t(i / blockSize)};
+                Cipher::encodeBlocks(master, block.data(), block.data(), 1);
+                for (size_t j = 0; j < nonceSize; j += blockSize)
+                {
+                    for (size_t k = 0; k < blockSize; ++k)
+                        block[k] ^= nonce[j + k];
+                    Cipher::encodeBlocks(master, block.data(), block.data(), 1);
+                }
+                copy(block.begin(), block.begin() + min(blockSize, key.size() - i), key.begin() + i);
+            }
+            return key;
+        }
+
+        // multiplication by x in GF(2^n), the block read as a big-endian number
+        static Block twice(const Block &block)
+        {
+            Block result;
+            for (size_t i = 0; i < blockSize; ++i)
+                result[i] = uint8_t(block[i] << 1 | (i + 1 < blockSize ? block[i + 1] >> 7 : 0));
+            if (block[0] & 0x80)
+                result[blockSize - 1] ^= blockSize == 8 ? 0x1B : 0x87;
+            return result;
+        }
+    };
+
+    static uint64_t sealedSize(uint64_t bytes, size_t chunkBytes = defaultChunk)
+    {
+        return headerSize + bytes + (bytes + chunkBytes - 1) / chunkBytes * entrySize + footerSize;
+    }
+
+    // bytes of plaintext from in into a container of sealedSize(bytes,
+    // chunkBytes) bytes at out; chunkBytes is a positive multiple of the
+    // block size up to maxChunk
+    static void seal(const Keys &keys, const uint8_t *in, uint64_t bytes, uint8_t *out, size_t chunkBytes = defaultChunk,
+                     unsigned threads = thread::hardware_concurrency())
+    {
+        if (!chunkBytes || chunkBytes % blockSize || chunkBytes > maxChunk)
+            throw invalid_argument("RC5Container: chunks are a positive multiple of the block size up to 16 MiB");
+        const uint64_t chunks = (bytes + chunkBytes - 1) / chunkBytes;
+
+        memcpy(out, "RC5CHNK1", 8);
+        out[8] = w;
+        out[9] = r;
+        out[10] = b;
+        out[11] = 0;
+        put(out + 12, chunkBytes, 4);
+        random(out + 16, nonceSize);
+        const Schedule cipher = keys.cipher(out + 16);
+
+        uint8_t *index = out + headerSize + bytes;
+        forChunks(chunks, threads, [&](uint64_t first, uint64_t last) {
+            for (uint64_t k = first; k < last;)
+            {
+                const size_t count = group(k, last, chunks, bytes % chunkBytes);
+                const size_t n = min<uint64_t>(chunkBytes, bytes - k * chunkBytes);
+                const uint8_t *ciphertexts[Simd::lanes];
+                Block tags[Simd::lanes];
+                for (size_t i = 0; i < count; ++i)
+                {
+                    ciphertexts[i] = out + headerSize + (k + i) * chunkBytes;
+                    Parallel::ctr(cipher, Block{}, (k + i) * (chunkBytes / blockSize), in + (k + i) * chunkBytes,
+                                  out + headerSize + (k + i) * chunkBytes, n, 1);
+                }
+                chunkTags(keys, out + 16, k, count, ciphertexts, n, tags);
+                for (size_t i = 0; i < count; ++i)
+                    copy(tags[i].begin(), tags[i].end(), index + (k + i) * entrySize);
+                k += count;
+            }
+        });
+
+        uint8_t *footer = index + chunks * entrySize;
+        put(footer, bytes, 8);
+        const Block tag = indexTag(keys, out, index, chunks * entrySize, footer);
+        copy(tag.begin(), tag.end(), footer + 8);
+        memcpy(footer + 8 + blockSize, "RC5CIDX1", 8);
+    }
+
+    // random access to a sealed file; pread from several threads at once is fine
+    class Reader
+    {
+    public:
+        // reads and authenticates header, index and footer; throws
+        // runtime_error if the file is not a container for this key
+        Reader(const Keys &keys, int fd) : keys_(keys), fd_(fd)
+        {
+            struct stat info;
+            if (fstat(fd, &info) != 0)
+                throw system_error(errno, generic_category(), "cannot read container");
+            const uint64_t fileSize = info.st_size;
+            if (fileSize < headerSize + footerSize)
+                throw runtime_error("not an rc5 container");
+
+            uint8_t footer[footerSize];
+            readAt(header_, headerSize, 0);
+            readAt(footer, footerSize, fileSize - footerSize);
+            if (memcmp(header_, "RC5CHNK1", 8) || memcmp(footer + 8 + blockSize, "RC5CIDX1", 8))
+                throw runtime_error("not an rc5 container");
+            if (header_[8] != w || header_[9] != r || header_[10] != b)
+                throw runtime_error("not an RC5-" + to_string(w) + "/" + to_string(r) + "/" + to_string(b) + " container");
+            chunkBytes_ = get(header_ + 12, 4);
+            size_ = get(footer, 8);
+            if (!chunkBytes_ || chunkBytes_ % blockSize || chunkBytes_ > maxChunk || size_ > fileSize || sealedSize(size_, chunkBytes_) != fileSize)
+                throw runtime_error("container is cut short or malformed");
+
+            index_.resize((size_ + chunkBytes_ - 1) / chunkBytes_ * entrySize);
+            readAt(index_.data(), index_.size(), headerSize + size_);
+            if (!equal(indexTag(keys_, header_, index_.data(), index_.size(), footer), footer + 8))
+                throw runtime_error("container index fails authentication");
+            cipher_ = keys_.cipher(header_ + 16);
+        }
+
+        uint64_t size() const
+        {
+            return size_;
+        }
+
+        size_t chunkBytes() const
+        {
+            return chunkBytes_;
+        }
+
+        // like pread(2): up to n bytes of plaintext from offset, fewer at the
+        // end; only the chunks that cover the range are read, authenticated
+        // and decrypted. Throws runtime_error if one of them was altered
+        size_t pread(uint8_t *buffer, size_t n, uint64_t offset, unsigned threads = 1) const
+        {
+            if (offset >= size_ || !n)
+                return 0;
+            n = min<uint64_t>(n, size_ - offset);
+            const uint64_t first = offset / chunkBytes_, last = (offset + n - 1) / chunkBytes_;
+            const uint64_t chunks = (size_ + chunkBytes_ - 1) / chunkBytes_;
+            forChunks(last - first + 1, threads, [&](uint64_t from, uint64_t to) {
+                vector<uint8_t> scratch;
+                for (uint64_t k = first + from; k < first + to;)
+                {
+                    const size_t count = group(k, first + to, chunks, size_ % chunkBytes_);
+                    const size_t length = min<uint64_t>(chunkBytes_, size_ - k * chunkBytes_);
+                    const uint8_t *ciphertexts[Simd::lanes];
+                    uint8_t *data[Simd::lanes];
+                    size_t lo[Simd::lanes], hi[Simd::lanes];
+                    Block tags[Simd::lanes];
+                    for (size_t i = 0; i < count; ++i)
+                    {
+                        const uint64_t start = (k + i) * chunkBytes_;
+                        lo[i] = max(offset, start) - start;
+                        hi[i] = min(offset + n, start + length) - start;
+                        // a whole chunk goes straight to the buffer, a part through
+                        // scratch; only the first and the last chunk can be parts
+                        data[i] = buffer + (start + lo[i] - offset);
+                        if (lo[i] || hi[i] < length)
+                        {
+                            scratch.resize(2 * chunkBytes_);
+                            data[i] = scratch.data() + (k + i == first ? 0 : chunkBytes_);
+                        }
+                        readAt(data[i], length, headerSize + start);
+                        ciphertexts[i] = data[i];
+                    }
+                    chunkTags(keys_, header_ + 16, k, count, ciphertexts, length, tags);
+                    for (size_t i = 0; i < count; ++i)
+                    {
+                        if (!equal(tags[i], &index_[(k + i) * entrySize]))
+                            throw runtime_error("chunk " + to_string(k + i) + " fails authentication");
+                        // from the block holding lo on
+                        const size_t skip = lo[i] / blockSize * blockSize;
+                        Parallel::ctr(cipher_, Block{}, ((k + i) * chunkBytes_ + skip) / blockSize, data[i] + skip, data[i] + skip,
+                                      hi[i] - skip, 1);
+                        if (lo[i] || hi[i] < length)
+                            memcpy(buffer + ((k + i) * chunkBytes_ + lo[i] - offset), data[i] + lo[i], hi[i] - lo[i]);
+                    }
+                    k += count;
+                }
+            });
+            return n;
+        }
+
+    private:
+        void readAt(uint8_t *data, size_t bytes, uint64_t offset) const
+        {
+            for (size_t done = 0; done < bytes;)
+            {
+                const ssize_t n = ::pread(fd_, data + done, bytes - done, offset + done);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n < 0)
+                    throw system_error(errno, generic_category(), "cannot read container");
+                if (n == 0)
+                    throw runtime_error("container is cut short or malformed");
+                done += n;
+            }
+        }
+
+        // in constant time, so a forger learns nothing from how long it took
+        static bool equal(const Block &tag, const uint8_t *expected)
+        {
+            uint8_t difference = 0;
+            for (size_t i = 0; i < blockSize; ++i)
+                difference |= tag[i] ^ expected[i];
+            return !difference;
+        }
+
+        Keys keys_;
+        Schedule cipher_;
+        int fd_;
+        uint8_t header_[headerSize];
+        size_t chunkBytes_ = 0;
+        uint64_t size_ = 0;
+        vector<uint8_t> index_;
+    };
+
+private:
+    // CMAC (NIST SP 800-38B) with RC5 as the block cipher, fed in pieces
+    class Cmac
+    {
+    public:
+        explicit Cmac(const Keys &keys) : keys_(keys)
+        {
+        }
+
+        void update(const uint8_t *data, size_t bytes)
+        {
+            while (bytes)
+            {
+                // the last block is kept back for final(), full or not
+                if (filled_ == blockSize)
+                {
+                    absorb(buffer_);
+                    filled_ = 0;
+                }
+                if (!filled_)
+                    for (; bytes > blockSize; data += blockSize, bytes -= blockSize)
+                        absorb(data);
+                const size_t n = min(bytes, blockSize - filled_);
+                memcpy(buffer_ + filled_, data, n);
+                filled_ += n;
+                data += n;
+                bytes -= n;
+            }
+        }
+
+        Block final()
+        {
+            const Block &k = filled_ == blockSize ? keys_.k1 : keys_.k2;
+            if (filled_ < blockSize)
+            {
+                buffer_[filled_] = 0x80;
+                memset(buffer_ + filled_ + 1, 0, blockSize - filled_ - 1);
+            }
+            for (size_t i = 0; i < blockSize; ++i)
+                buffer_[i] ^= k[i];
+            absorb(buffer_);
+            Block tag;
+            Cipher::unpackWord(tag, 0, A_);
+            Cipher::unpackWord(tag, u, B_);
+            return tag;
+        }
+
+    private:
+        void absorb(const uint8_t *block)
+        {
+            A_ ^= Cipher::packWord(block, 0);
+            B_ ^= Cipher::packWord(block, u);
+            Cipher::encodeWords(keys_.mac, A_, B_);
+        }
+
+        const Keys &keys_;
+        Word A_ = 0, B_ = 0;
+        uint8_t buffer_[blockSize];
+        size_t filled_ = 0;
+    };
+
+    // how many chunks from k on (before last) can go through chunkTags
+    // together: up to a vector of them, and only of the same length, which
+    // leaves out the file's last chunk if it is shorter
+    static size_t group(uint64_t k, uint64_t last, uint64_t chunks, uint64_t shortLast)
+    {
+        size_t count = min<uint64_t>(Simd::lanes, last - k);
+        if (count > 1 && k + count == chunks && shortLast)
+            --count;
+        return count;
+    }
+
+    // the tags of count chunks of bytes each, chunk first and on, with CMAC
+    // in every vector lane. A chunk's message is its prefix (nonce, number,
+    // length; whole blocks) followed by its ciphertext; lanes past count
+    // repeat the last chunk
+    static void chunkTags(const Keys &keys, const uint8_t *nonce, uint64_t first, size_t count, const uint8_t *const *ciphertexts,
+                          size_t bytes, Block *tags)
+    {
+        constexpr size_t prefixBytes = nonceSize + 16;
+        uint8_t prefixes[Simd::lanes][prefixBytes], lastBlocks[Simd::lanes][blockSize];
+        const uint8_t *bodies[Simd::lanes];
+        const size_t total = prefixBytes + bytes;
+        const size_t blocks = (total + blockSize - 1) / blockSize;
+        const size_t lastStart = (blocks - 1) * blockSize, lastBytes = total - lastStart;
+        const Block &k = lastBytes == blockSize ? keys.k1 : keys.k2;
+        for (size_t lane = 0; lane < Simd::lanes; ++lane)
+        {
+            const size_t i = min(lane, count - 1);
+            memcpy(prefixes[lane], nonce, nonceSize);
+            put(prefixes[lane] + nonceSize, first + i, 8);
+            put(prefixes[lane] + nonceSize + 8, bytes, 8);
+            bodies[lane] = ciphertexts[i];
+            // the last block padded unless it is whole, and masked
+            const uint8_t *last = lastStart < prefixBytes ? prefixes[lane] + lastStart : bodies[lane] + (lastStart - prefixBytes);
+            memcpy(lastBlocks[lane], last, lastBytes);
+            if (lastBytes < blockSize)
+            {
+                lastBlocks[lane][lastBytes] = 0x80;
+                memset(lastBlocks[lane] + lastBytes + 1, 0, blockSize - lastBytes - 1);
+            }
+            for (size_t j = 0; j < blockSize; ++j)
+                lastBlocks[lane][j] ^= k[j];
+        }
+
+        Vector A = 0, B = 0;
+        const auto absorb = [&](auto block) {
+            A ^= Vector([&](auto lane) { return Cipher::packWord(block(lane), 0); });
+            B ^= Vector([&](auto lane) { return Cipher::packWord(block(lane), u); });
+            Simd::encodeWords(keys.mac, A, B);
+        };
+        for (size_t at = 0; at < prefixBytes && at < lastStart; at += blockSize)
+            absorb([&](size_t lane) { return prefixes[lane] + at; });
+        for (size_t at = prefixBytes; at < lastStart; at += blockSize)
+            absorb([&](size_t lane) { return bodies[lane] + (at - prefixBytes); });
+        absorb([&](size_t lane) { return lastBlocks[lane]; });
+        for (size_t i = 0; i < count; ++i)
+        {
+            Cipher::unpackWord(tags[i], 0, Word(A[i]));
+            Cipher::unpackWord(tags[i], u, Word(B[i]));
+        }
+    }
+
+    // footer starts with the size
+    static Block indexTag(const Keys &keys, const uint8_t *header, const uint8_t *index, size_t indexBytes, const uint8_t *footer)
+    {
+        Cmac mac(keys);
+        mac.update(header, headerSize);
+        mac.update(index, indexBytes);
+        mac.update(footer, 8);
+        return mac.final();
+    }
+
+    static void put(uint8_t *out, uint64_t value, size_t bytes)
+    {
+        for (size_t i = 0; i < bytes; ++i)
+            out[i] = uint8_t(value >> 8 * i);
+    }
+
+    static uint64_t get(const uint8_t *in, size_t bytes)
+    {
+        uint64_t value = 0;
+        for (size_t i = 0; i < bytes; ++i)
+            value |= uint64_t(in[i]) << 8 * i;
+        return value;
+    }
+
+    static void random(uint8_t *out, size_t bytes)
+    {
+        for (size_t done = 0; done < bytes;)
+        {
+            const ssize_t n = getrandom(out + done, bytes - done, 0);
+            if (n < 0 && errno != EINTR)
+                throw system_error(errno, generic_category(), "cannot draw random bytes");
+            done += max<ssize_t>(n, 0);
+        }
+    }
+
+    // runs chunks(first, last) over contiguous ranges of count chunks, the
+    // last one on the calling thread; the first exception is passed on
+    template <typename Chunks>
+    static void forChunks(uint64_t count, unsigned threads, Chunks &&chunks)
+    {
+        const uint64_t parts = max<uint64_t>(1, min<uint64_t>(threads, count));
+        vector<exception_ptr> errors(parts);
+        const auto part = [&](uint64_t i) {
+            try
+            {
+                chunks(count * i / parts, count * (i + 1) / parts);
+            }
+            catch (...)
+            {
+                errors[i] = current_exception();
+            }
+        };
+        vector<thread> workers;
+        for (uint64_t i = 0; i + 1 < parts; ++i)
+            workers.emplace_back(part, i);
+        part(parts - 1);
+        for (thread &worker : workers)
+            worker.join();
+        for (const exception_ptr &error : errors)
+            if (error)
+                rethrow_exception(error);
+    }
+};
@@ -0,0 +1,237 @@
+#pragma once
+
+#include "RC5.hpp"
+
+#if defined(__x86_64__)
+
+#include <cstring>
+#include <system_error>
+
+#include <sys/mman.h>
+
+//////// RC5 kernels generated at runtime for one expanded key
+
+// emits straight-line x86-64 code for a single S table: every S[i] becomes an
+// immediate operand and the r rounds are fully unrolled, only the loop over
+// blocks remains. Both functions follow the SysV ABI and have the signature
+//     void (const uint8_t *in, uint8_t *out, size_t blocks)
+// with in and out allowed to alias, same as RC5::encodeBlocks.
+template <uint8_t w>
+class RC5Jit
+{
+    // there is no general purpose register for w = 128
+    static_assert(w <= 64);
+
+public:
+    using Word = typename WordT<w>::type;
+    using Function = void (*)(const uint8_t *in, uint8_t *out, size_t blocks);
+
+    static constexpr uint8_t u = w / 8;
+
+    // S holds the 2 * (r + 1) words returned by setupS
+    RC5Jit(const Word *S, uint8_t r)
+    {
+        vector<uint8_t> code;
+        emitKernel(code, S, r, true);
+        const size_t decodeOffset = code.size();
+        emitKernel(code, S, r, false);
+
+        size_ = (code.size() + 4095) & ~size_t(4095);
+        void *mem = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED)
+            throw system_error(errno, generic_category(), "RC5Jit: mmap");
+        memcpy(mem, code.data(), code.size());
+        // never writable and executable at the same time
+        if (mprotect(mem, size_, PROT_READ | PROT_EXEC) != 0)
+        {
+            const int err = errno;
+            munmap(mem, size_);
+            throw system_error(err, generic_category(), "RC5Jit: mprotect");
+        }
+
+        code_ = static_cast<uint8_t *>(mem);
+        codeSize_ = code.size();
+        encode_ = reinterpret_cast<Function>(code_);
+        decode_ = reinterpret_cast<Function>(code_ + decodeOffset);
+    }
+
+    template <uint8_t r, uint8_t b>
+    explicit RC5Jit(const typename RC5<w, r, b>::Schedule &S) : RC5Jit(S.data(), r) {}
+
+    RC5Jit(const RC5Jit &) = delete;
+    RC5Jit &operator=(const RC5Jit &) = delete;
+
+    ~RC5Jit()
+    {
+        munmap(code_, size_);
+    }
+
+    void encode(const uint8_t *in, uint8_t *out, size_t blocks) const { encode_(in, out, blocks); }
+    void decode(const uint8_t *in, uint8_t *out, size_t blocks) const { decode_(in, out, blocks); }
+
+    Function encodeFunction() const { return encode_; }
+    Function decodeFunction() const { return decode_; }
+
+    // bytes of machine code emitted for both directions
+    size_t codeSize() const { return codeSize_; }
+
+private:
+    // register numbers as used in ModRM/REX
+    enum Reg : uint8_t
+    {
+        RAX = 0, // A
+        RCX = 1, // rotate amount
+        RDX = 2, // remaining blocks
+        RSI = 6, // out
+        RDI = 7, // in
+        R8 = 8,  // B
+        R10 = 10 // scratch for 64-bit immediates
+    };
+
+    // operand-size prefix and REX for a w-bit operation with the given ModRM registers
+    static void prefix(vector<uint8_t> &code, uint8_t reg, uint8_t rm, bool wide = w == 64)
+    {
+        if (w == 16 && !wide)
+            code.push_back(0x66);
+        const uint8_t rex = 0x40 | (wide ? 0x08 : 0) | ((reg >> 3) << 2) | (rm >> 3);
+        if (rex != 0x40)
+            code.push_back(rex);
+    }
+
+    static void modrm(vector<uint8_t> &code, uint8_t mod, uint8_t reg, uint8_t rm)
+    {
+        code.push_back((mod << 6) | ((reg & 7) << 3) | (rm & 7));
+    }
+
+    static void imm(vector<uint8_t> &code, uint64_t value, size_t bytes)
+    {
+        for (size_t i = 0; i < bytes; ++i)
+            code.push_back(uint8_t(value >> (8 * i)));
+    }
+
+    // op reg, [base + disp8] (0x8B) or op [base + disp8], reg (0x89)
+    static void memory(vector<uint8_t> &code, uint8_t opcode, Reg reg, Reg base, uint8_t disp)
+    {
+        prefix(code, reg, base);
+        code.push_back(opcode);
+        modrm(code, 1, reg, base);
+        code.push_back(disp);
+    }
+
+    // op dst, src for the register/register forms (xor 0x31, mov 0x89, add 0x01, sub 0x29)
+    static void binary(vector<uint8_t> &code, uint8_t opcode, Reg dst, Reg src)
+    {
+        prefix(code, src, dst);
+        code.push_back(opcode);
+        modrm(code, 3, src, dst);
+    }
+
+    // rol (ext 0) or ror (ext 1) dst, cl
+    static void rotate(vector<uint8_t> &code, uint8_t ext, Reg dst)
+    {
+        prefix(code, 0, dst);
+        code.push_back(0xD3);
+        modrm(code, 3, ext, dst);
+    }
+
+    // add (ext 0) or sub (ext 5) dst, S[i]
+    static void immediate(vector<uint8_t> &code, uint8_t ext, Reg dst, Word value)
+    {
+        if (w == 64 && int64_t(value) != int64_t(int32_t(value)))
+        {
+            // movabs r10, imm64; add/sub dst, r10
+            prefix(code, 0, R10);
+            code.push_back(0xB8 + (R10 & 7));
+            imm(code, value, 8);
+            binary(code, ext == 0 ? 0x01 : 0x29, dst, R10);
+            return;
+        }
+        prefix(code, 0, dst);
+        code.push_back(0x81);
+        modrm(code, 3, ext, dst);
+        imm(code, value, w == 16 ? 2 : 4);
+    }
+
+    // add/sub a 64-bit register, imm8 (pointer bumps and the block counter)
+    static void pointer(vector<uint8_t> &code, uint8_t ext, Reg dst, uint8_t value)
+    {
+        prefix(code, 0, dst, true);
+        code.push_back(0x83);
+        modrm(code, 3, ext, dst);
+        code.push_back(value);
+    }
+
+    static void emitKernel(vector<uint8_t> &code, const Word *S, uint8_t r, bool encrypt)
+    {
+        // test rdx, rdx; jz done
+        prefix(code, RDX, RDX, true);
+        code.push_back(0x85);
+        modrm(code, 3, RDX, RDX);
+        code.insert(code.end(), {0x0F, 0x84, 0, 0, 0, 0});
+        const size_t skip = code.size();
+
+        const size_t loop = code.size();
+        memory(code, 0x8B, RAX, RDI, 0);
+        memory(code, 0x8B, R8, RDI, u);
+
+        if (encrypt)
+        {
+            immediate(code, 0, RAX, S[0]);
+            immediate(code, 0, R8, S[1]);
+            for (unsigned i = 1; i <= r; ++i)
+            {
+                // A = rotl(A ^ B, B) + S[2i]
+                binary(code, 0x31, RAX, R8);
+                binary(code, 0x89, RCX, R8);
+                rotate(code, 0, RAX);
+                immediate(code, 0, RAX, S[2 * i]);
+                // B = rotl(B ^ A, A) + S[2i + 1]
+                binary(code, 0x31, R8, RAX);
+                binary(code, 0x89, RCX, RAX);
+                rotate(code, 0, R8);
+                immediate(code, 0, R8, S[2 * i + 1]);
+            }
+        }
+        else
+        {
+            for (unsigned i = r; i > 0; --i)
+            {
+                // B = rotr(B - S[2i + 1], A) ^ A
+                immediate(code, 5, R8, S[2 * i + 1]);
+                binary(code, 0x89, RCX, RAX);
+                rotate(code, 1, R8);
+                binary(code, 0x31, R8, RAX);
+                // A = rotr(A - S[2i], B) ^ B
+                immediate(code, 5, RAX, S[2 * i]);
+                binary(code, 0x89, RCX, R8);
+                rotate(code, 1, RAX);
+                binary(code, 0x31, RAX, R8);
+            }
+            immediate(code, 5, R8, S[1]);
+            immediate(code, 5, RAX, S[0]);
+        }
+
+        memory(code, 0x89, RAX, RSI, 0);
+        memory(code, 0x89, R8, RSI, u);
+        pointer(code, 0, RDI, 2 * u);
+        pointer(code, 0, RSI, 2 * u);
+        pointer(code, 5, RDX, 1);
+
+        // jnz loop
+        code.insert(code.end(), {0x0F, 0x85});
+        imm(code, uint32_t(int32_t(loop - (code.size() + 4))), 4);
+
+        const int32_t rel = code.size() - skip;
+        memcpy(&code[skip - 4], &rel, 4);
+        // ret
+        code.push_back(0xC3);
+    }
+
+    uint8_t *code_ = nullptr;
+    size_t size_ = 0;
+    size_t codeSize_ = 0;
+    Function encode_ = nullptr;
+    Function decode_ = nullptr;
+};
+
+#endif
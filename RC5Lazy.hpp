@@ -0,0 +1,287 @@
+#pragma once
+
+#include "RC5Parallel.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/userfaultfd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+//////// LAZY DECRYPTION
+
+// the plaintext of a CTR-encrypted file as memory that is decrypted on first
+// touch. The region is reserved up front but holds no pages; a userfaultfd
+// handler thread catches the first access to every window of it, reads that
+// window's ciphertext, decrypts it with the counter seeked to the window and
+// copies it in. Opening is O(1) whatever the size, and memory and work follow
+// the pages actually read. A window is filled in one go, so a fault that
+// lands on a window being filled just waits for it. Pages stay once
+// decrypted and are never written back
+template <uint8_t w, uint8_t r, uint8_t b>
+class RC5LazyCtr
+{
+private:
+    using Cipher = RC5<w, r, b>;
+    using Parallel = RC5Parallel<w, r, b>;
+
+public:
+    using Schedule = typename Cipher::Schedule;
+    using Block = typename Parallel::Block;
+
+    static constexpr size_t blockSize = 2 * Cipher::u;
+
+    struct Options
+    {
+        size_t windowBytes = 1 << 16; // decrypted per fault, rounded up to pages
+    };
+
+    // bytes of plaintext from the ciphertext at offset in fd, encrypted in
+    // CTR mode under S and iv from block 0 on; throws system_error if the
+    // kernel has no userfaultfd or does not let us use it
+    RC5LazyCtr(const Schedule &S, const Block &iv, int fd, uint64_t offset, uint64_t bytes, const Options &options = {})
+        : S_(S), iv_(iv), fd_(fd), offset_(offset), bytes_(bytes)
+    {
+        const size_t page = sysconf(_SC_PAGESIZE);
+        window_ = max<size_t>(1, (options.windowBytes + page - 1) / page) * page;
+        mapped_ = (bytes + page - 1) / page * page;
+        if (!mapped_)
+            return;
+
+        uffd_ = open();
+        try
+        {
+            uffdio_api api{UFFD_API, 0, 0};
+            if (ioctl(uffd_, UFFDIO_API, &api) != 0)
+                throw system_error(errno, generic_category(), "cannot use userfaultfd");
+            void *region = mmap(nullptr, mapped_, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (region == MAP_FAILED)
+                throw system_error(errno, generic_category(), "cannot reserve memory");
+            data_ = static_cast<uint8_t *>(region);
+            uffdio_register registration{{uint64_t(uintptr_t(data_)), mapped_}, UFFDIO_REGISTER_MODE_MISSING, 0};
+            if (ioctl(uffd_, UFFDIO_REGISTER, &registration) != 0)
+                throw system_error(errno, generic_category(), "cannot register memory with userfaultfd");
+            stop_ = eventfd(0, EFD_CLOEXEC);
+            if (stop_ < 0)
+                throw system_error(errno, generic_category(), "cannot create eventfd");
+            handler_ = thread([this] { handle(); });
+        }
+        catch (...)
+        {
+            release();
+            throw;
+        }
+    }
+
+    RC5LazyCtr(const RC5LazyCtr &) = delete;
+    RC5LazyCtr &operator=(const RC5LazyCtr &) = delete;
+
+    ~RC5LazyCtr()
+    {
+        release();
+    }
+
+    // the plaintext; reading it may block on the handler
+    const uint8_t *data() const
+    {
+        return data_;
+    }
+
+    uint64_t size() const
+    {
+        return bytes_;
+    }
+
+    // windows decrypted so far
+    uint64_t faults() const
+    {
+        return faults_.load(memory_order_relaxed);
+    }
+
+    // a window that could not be read is filled with zeros, since the access
+    // that faulted cannot fail; this throws the first such error
+    void check() const
+    {
+        lock_guard<mutex> lock(errorLock_);
+        if (error_)
+            rethrow_exception(error_);
+    }
+
+private:
+    // a userfaultfd that takes kernel faults too, so the region can be handed
+    // to system calls; without privilege only faults from user space, and
+    // from /dev/userfaultfd where the system call is filtered
+    static int open()
+    {
+        int uffd = int(syscall(__NR_userfaultfd, O_CLOEXEC | O_NONBLOCK));
+#ifdef UFFD_USER_MODE_ONLY
+        if (uffd < 0 && errno == EPERM)
+            uffd = int(syscall(__NR_userfaultfd, O_CLOEXEC | O_NONBLOCK | UFFD_USER_MODE_ONLY));
+#endif
+#ifdef USERFAULTFD_IOC_NEW
+        if (uffd < 0)
+        {
+            const int device = ::open("/dev/userfaultfd", O_RDWR | O_CLOEXEC);
+            if (device >= 0)
+            {
+                uffd = ioctl(device, USERFAULTFD_IOC_NEW, O_CLOEXEC | O_NONBLOCK);
+                close(device);
+            }
+        }
+#endif
+        if (uffd < 0)
+            throw system_error(errno, generic_category(), "cannot open userfaultfd");
+        return uffd;
+    }
+
+    void handle()
+    {
+        vector<uint8_t> scratch(window_);
+        pollfd fds[2] = {{uffd_, POLLIN, 0}, {stop_, POLLIN, 0}};
+        for (;;)
+        {
+            if (poll(fds, 2, -1) < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                abandon(errno, "cannot wait for page faults");
+                return;
+            }
+            if (fds[1].revents)
+                return;
+            uffd_msg message;
+            const ssize_t n = read(uffd_, &message, sizeof(message));
+            if (n < 0 && (errno == EAGAIN || errno == EINTR))
+                continue;
+            if (n != sizeof(message))
+            {
+                abandon(n < 0 ? errno : EIO, "cannot read page faults");
+                return;
+            }
+            if (message.event != UFFD_EVENT_PAGEFAULT)
+                continue;
+            const uint64_t start = (message.arg.pagefault.address - uintptr_t(data_)) / window_ * window_;
+            fill(start, min<uint64_t>(window_, mapped_ - start), scratch.data());
+        }
+    }
+
+    // decrypts the window at start and maps it in
+    void fill(uint64_t start, size_t length, uint8_t *scratch)
+    {
+        const size_t plain = min<uint64_t>(length, bytes_ - start);
+        try
+        {
+            for (size_t done = 0; done < plain;)
+            {
+                const ssize_t n = pread(fd_, scratch + done, plain - done, offset_ + start + done);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n < 0)
+                    throw system_error(errno, generic_category(), "cannot read ciphertext");
+                if (n == 0)
+                    throw system_error(EIO, generic_category(), "ciphertext is shorter than the plaintext");
+                done += n;
+            }
+            Parallel::ctr(S_, iv_, start / blockSize, scratch, scratch, plain, 1);
+        }
+        catch (...)
+        {
+            fail(current_exception());
+            memset(scratch, 0, plain);
+        }
+        // past the end of the plaintext the last page reads as zeros
+        memset(scratch + plain, 0, length - plain);
+
+        // counted before the copy wakes the thread that faulted
+        faults_.fetch_add(1, memory_order_relaxed);
+        for (size_t done = 0; done < length;)
+        {
+            uffdio_copy copy{uint64_t(uintptr_t(data_) + start + done), uint64_t(uintptr_t(scratch + done)), length - done, 0, 0};
+            if (ioctl(uffd_, UFFDIO_COPY, &copy) == 0)
+                break;
+            // another fault on the same window, queued before it was filled
+            if (errno == EEXIST)
+            {
+                faults_.fetch_sub(1, memory_order_relaxed);
+                uffdio_range range{uint64_t(uintptr_t(data_) + start), length};
+                ioctl(uffd_, UFFDIO_WAKE, &range);
+                return;
+            }
+            if (errno != EAGAIN)
+            {
+                // the thread that faulted must not wait forever: zeros, or
+                // else a wake that faults it again
+                fail(make_exception_ptr(system_error(errno, generic_category(), "cannot map decrypted pages")));
+                uffdio_zeropage zeros{{uint64_t(uintptr_t(data_) + start + done), length - done}, 0, 0};
+                if (ioctl(uffd_, UFFDIO_ZEROPAGE, &zeros) != 0)
+                {
+                    uffdio_range range{uint64_t(uintptr_t(data_) + start), length};
+                    ioctl(uffd_, UFFDIO_WAKE, &range);
+                }
+                return;
+            }
+            // interrupted part way; copy holds what went in
+            if (copy.copy > 0)
+                done += copy.copy;
+        }
+    }
+
+    // the handler cannot go on: unregistering the region wakes the threads
+    // waiting on it, and from then on pages that were never filled fault in
+    // as zeros
+    void abandon(int error, const char *what)
+    {
+        fail(make_exception_ptr(system_error(error, generic_category(), what)));
+        uffdio_range range{uint64_t(uintptr_t(data_)), mapped_};
+        ioctl(uffd_, UFFDIO_UNREGISTER, &range);
+    }
+
+    void fail(exception_ptr error)
+    {
+        lock_guard<mutex> lock(errorLock_);
+        if (!error_)
+            error_ = error;
+    }
+
+    void release()
+    {
+        if (handler_.joinable())
+        {
+            const uint64_t one = 1;
+            if (write(stop_, &one, sizeof(one)) != sizeof(one))
+                terminate();
+            handler_.join();
+        }
+        if (stop_ >= 0)
+            close(stop_);
+        if (data_)
+            munmap(data_, mapped_);
+        if (uffd_ >= 0)
+            close(uffd_);
+        stop_ = uffd_ = -1;
+        data_ = nullptr;
+    }
+
+    Schedule S_;
+    Block iv_;
+    int fd_;
+    uint64_t offset_, bytes_;
+    size_t window_ = 0, mapped_ = 0;
+    uint8_t *data_ = nullptr;
+    int uffd_ = -1, stop_ = -1;
+    thread handler_;
+    atomic<uint64_t> faults_{0};
+    mutable mutex errorLock_;
+    exception_ptr error_;
+};
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "RC5Modes.hpp"
+
+//////// LITERALS ENCRYPTED AT COMPILE TIME
+
+enum class RC5Mode
+{
+    Cbc,
+    Ctr
+};
+
+// ciphertext of a string or byte literal, computed during compilation with the
+// key K (an array<uint8_t, b> non-type template parameter, as for RC5Fixed).
+// Only the ciphertext and the iv end up in the binary; the plaintext literal is
+// consumed by constant evaluation. This keeps secrets out of `strings` and
+// static scans, not away from anyone who can run or debug the binary: the key
+// is in there too
+template <uint8_t w, uint8_t r, auto K, RC5Mode mode, size_t N>
+class RC5Literal
+{
+private:
+    using Fixed = RC5Fixed<w, r, K>;
+    using Cbc = RC5Cbc<w, r, K.size()>;
+    using Ctr = RC5Ctr<w, r, K.size()>;
+    using Block = typename Ctr::Block;
+
+public:
+    // CBC pads to whole blocks, CTR keeps the length
+    static constexpr size_t storedSize = mode == RC5Mode::Cbc ? Cbc::paddedSize(N) : N;
+
+    // salt makes the iv unique per literal, so no two CTR literals share a keystream
+    consteval RC5Literal(const array<uint8_t, N> &plaintext, uint64_t salt)
+    {
+        // FNV-1a over salt and content, spread over the iv
+        uint64_t hash = 0xcbf29ce484222325;
+        for (size_t i = 0; i < 8; ++i)
+            hash = (hash ^ uint8_t(salt >> (8 * i))) * 0x100000001b3;
+        for (uint8_t byte : plaintext)
+            hash = (hash ^ byte) * 0x100000001b3;
+        for (size_t i = 0; i < iv_.size(); ++i)
+        {
+            hash = (hash ^ i) * 0x100000001b3;
+            iv_[i] = uint8_t(hash >> 56);
+        }
+
+        array<uint8_t, storedSize> buffer{};
+        for (size_t i = 0; i < N; ++i)
+            buffer[i] = plaintext[i];
+        if constexpr (mode == RC5Mode::Cbc)
+        {
+            for (size_t i = N; i < storedSize; ++i)
+                buffer[i] = uint8_t(storedSize - N);
+            Cbc::encrypt(Fixed::S, iv_, buffer.data(), data_.data(), storedSize / iv_.size());
+        }
+        else
+            Ctr::crypt(Fixed::S, iv_, 0, buffer.data(), data_.data(), N);
+    }
+
+    // the N plaintext bytes (including the terminating NUL of a string literal)
+    constexpr array<uint8_t, N> decrypt() const
+    {
+        return decrypt(data_);
+    }
+
+    // same at runtime only. The ciphertext is read through volatile, otherwise
+    // the optimizer folds decrypt() of a constexpr object and the plaintext
+    // lands in .rodata after all
+    array<uint8_t, N> reveal() const
+    {
+        array<uint8_t, storedSize> data;
+        const volatile uint8_t *source = data_.data();
+        for (size_t i = 0; i < storedSize; ++i)
+            data[i] = source[i];
+        return decrypt(data);
+    }
+
+    constexpr const array<uint8_t, storedSize> &ciphertext() const { return data_; }
+    constexpr const Block &iv() const { return iv_; }
+
+private:
+    constexpr array<uint8_t, N> decrypt(const array<uint8_t, storedSize> &data) const
+    {
+        array<uint8_t, storedSize> buffer{};
+        if constexpr (mode == RC5Mode::Cbc)
+            Cbc::decrypt(Fixed::S, iv_, data.data(), buffer.data(), storedSize / iv_.size());
+        else
+            Ctr::crypt(Fixed::S, iv_, 0, data.data(), buffer.data(), N);
+
+        array<uint8_t, N> plaintext{};
+        for (size_t i = 0; i < N; ++i)
+            plaintext[i] = buffer[i];
+        return plaintext;
+    }
+
+    Block iv_{};
+    array<uint8_t, storedSize> data_{};
+};
+
+template <uint8_t w, uint8_t r, auto K, RC5Mode mode, size_t N>
+consteval RC5Literal<w, r, K, mode, N> rc5EncryptString(const char (&literal)[N], uint64_t salt)
+{
+    array<uint8_t, N> bytes{};
+    for (size_t i = 0; i < N; ++i)
+        bytes[i] = uint8_t(literal[i]);
+    return RC5Literal<w, r, K, mode, N>(bytes, salt);
+}
+
+template <uint8_t w, uint8_t r, auto K, RC5Mode mode, size_t N>
+consteval RC5Literal<w, r, K, mode, N> rc5EncryptBytes(const array<uint8_t, N> &bytes, uint64_t salt)
+{
+    return RC5Literal<w, r, K, mode, N>(bytes, salt);
+}
+
+// every use site expands to its own lambda, so each literal gets its own pair
+// of statics: the ciphertext, constant-initialized in the binary (no startup
+// cost), and the plaintext, decrypted on first access. Function-local static
+// initialization is thread-safe, so concurrent first calls decrypt once and
+// the others wait for it.
+//
+//     static constexpr array<uint8_t, 16> key = {...};
+//     const char *password = RC5_STRING(32, 12, key, RC5Mode::Ctr, "hunter2");
+#define RC5_STRING(w, r, key, mode, literal)                                                     \
+    ([]() -> const char * {                                                                      \
+        static constexpr auto encrypted = rc5EncryptString<w, r, key, mode>(literal, __COUNTER__); \
+        static const auto plaintext = encrypted.reveal();                                       \
+        return reinterpret_cast<const char *>(plaintext.data());                                 \
+    }())
+
+// same for a constexpr array<uint8_t, N>, yields a const reference to the decrypted array
+#define RC5_BYTES(w, r, key, mode, bytes)                                                     \
+    ([]() -> const auto & {                                                                   \
+        static constexpr auto encrypted = rc5EncryptBytes<w, r, key, mode>(bytes, __COUNTER__); \
+        static const auto plaintext = encrypted.reveal();                                    \
+        return plaintext;                                                                     \
+    }())
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//////// USAGE METRICS
+
+// what the library did, counted per thread and summed on demand. Every
+// thread writes only its own cache-line aligned slot, so counting is a plain
+// load/add/store with no lock prefix and no false sharing
+enum Metric
+{
+    MetricBlocksEncrypted,
+    MetricBlocksDecrypted,
+    MetricKeysExpanded,
+    // for callers that keep expanded keys around, the library has no cache itself
+    MetricKeyCacheHits,
+    MetricKeyCacheMisses,
+    // bytes processed, one counter per mode of operation
+    MetricBytesEcb,
+    MetricBytesCbc,
+    MetricBytesCtr,
+    MetricCount
+};
+
+using MetricValues = array<uint64_t, MetricCount>;
+
+struct alignas(64) MetricSlot
+{
+    array<atomic<uint64_t>, MetricCount> values{};
+};
+
+class MetricsRegistry
+{
+public:
+    static MetricsRegistry &instance()
+    {
+        static MetricsRegistry registry;
+        return registry;
+    }
+
+    MetricSlot *attach()
+    {
+        lock_guard<mutex> lock(mutex_);
+        slots_.push_back(make_unique<MetricSlot>());
+        return slots_.back().get();
+    }
+
+    // folds the values of an exiting thread into the retired totals
+    void detach(MetricSlot *slot)
+    {
+        lock_guard<mutex> lock(mutex_);
+        for (int m = 0; m < MetricCount; ++m)
+            retired_[m] += slot->values[m].load(memory_order_relaxed);
+        for (auto it = slots_.begin(); it != slots_.end(); ++it)
+            if (it->get() == slot)
+            {
+                slots_.erase(it);
+                break;
+            }
+    }
+
+    MetricValues snapshot()
+    {
+        lock_guard<mutex> lock(mutex_);
+        MetricValues totals = retired_;
+        for (const auto &slot : slots_)
+            for (int m = 0; m < MetricCount; ++m)
+                totals[m] += slot->values[m].load(memory_order_relaxed);
+        return totals;
+    }
+
+private:
+    mutex mutex_;
+    vector<unique_ptr<MetricSlot>> slots_;
+    MetricValues retired_{};
+};
+
+// the calling thread's slot, registered on first use
+inline MetricSlot &metricsSlot()
+{
+    struct Holder
+    {
+        MetricSlot *slot = MetricsRegistry::instance().attach();
+        ~Holder() { MetricsRegistry::instance().detach(slot); }
+    };
+    thread_local Holder holder;
+    return *holder.slot;
+}
+
+inline void metricsAdd(Metric metric, uint64_t n = 1)
+{
+    atomic<uint64_t> &value = metricsSlot().values[metric];
+    value.store(value.load(memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+// totals over all threads, including the ones that already exited
+inline MetricValues metricsSnapshot()
+{
+    return MetricsRegistry::instance().snapshot();
+}
+
+// writes the totals in the Prometheus text format; the file is replaced
+// atomically so a textfile collector never reads a partial dump
+inline bool metricsWritePrometheus(const string &path)
+{
+    struct Description
+    {
+        const char *name, *help, *labels;
+    };
+    static constexpr Description descriptions[MetricCount] = {
+        {"rc5_blocks_encrypted_total", "Blocks encrypted.", ""},
+        {"rc5_blocks_decrypted_total", "Blocks decrypted.", ""},
+        {"rc5_keys_expanded_total", "Key schedules computed.", ""},
+        {"rc5_key_cache_hits_total", "Expanded keys found in a caller's key cache.", ""},
+        {"rc5_key_cache_misses_total", "Expanded keys missing from a caller's key cache.", ""},
+        {"rc5_bytes_total", "Bytes processed per mode of operation.", "{mode=\"ecb\"}"},
+        {"rc5_bytes_total", "", "{mode=\"cbc\"}"},
+        {"rc5_bytes_total", "", "{mode=\"ctr\"}"},
+    };
+
+    const MetricValues totals = metricsSnapshot();
+    const string temporary = path + ".tmp";
+    {
+        ofstream out(temporary, ios::trunc);
+        const char *previous = "";
+        for (int m = 0; m < MetricCount; ++m)
+        {
+            const Description &d = descriptions[m];
+            if (string(previous) != d.name)
+                out << "# HELP " << d.name << " " << d.help << "\n# TYPE " << d.name << " counter\n";
+            out << d.name << d.labels << " " << totals[m] << "\n";
+            previous = d.name;
+        }
+        if (!out.flush())
+            return false;
+    }
+    return rename(temporary.c_str(), path.c_str()) == 0;
+}
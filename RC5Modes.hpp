@@ -0,0 +1,120 @@
+#pragma once
+
+#include "RC5.hpp"
+
+//////// MODES OF OPERATION
+
+// CBC over whole blocks, as in RC5-CBC (RFC 2040); padding is up to the caller.
+// Everything is constexpr, so the same code encrypts at compile time and at runtime
+template <uint8_t w, uint8_t r, uint8_t b>
+class RC5Cbc
+{
+private:
+    using Cipher = RC5<w, r, b>;
+
+public:
+    using Word = typename Cipher::Word;
+    using Schedule = typename Cipher::Schedule;
+    using Block = array<uint8_t, 2 * Cipher::u>;
+
+    static constexpr uint8_t u = Cipher::u;
+
+    static constexpr void encrypt(const Schedule &S, const Block &iv, const uint8_t *in, uint8_t *out, size_t blocks)
+    {
+        RC5_METRIC_ADD(MetricBytesCbc, blocks * 2 * u);
+
+        Word A = Cipher::packWord(iv, 0);
+        Word B = Cipher::packWord(iv, u);
+        for (size_t k = 0; k < blocks; ++k, in += 2 * u, out += 2 * u)
+        {
+            A ^= Cipher::packWord(in, 0);
+            B ^= Cipher::packWord(in, u);
+            Cipher::encodeWords(S, A, B);
+            Cipher::unpackWord(out, 0, A);
+            Cipher::unpackWord(out, u, B);
+        }
+    }
+
+    // in and out may alias
+    static constexpr void decrypt(const Schedule &S, const Block &iv, const uint8_t *in, uint8_t *out, size_t blocks)
+    {
+        RC5_METRIC_ADD(MetricBytesCbc, blocks * 2 * u);
+
+        Word prevA = Cipher::packWord(iv, 0);
+        Word prevB = Cipher::packWord(iv, u);
+        for (size_t k = 0; k < blocks; ++k, in += 2 * u, out += 2 * u)
+        {
+            const Word C = Cipher::packWord(in, 0);
+            const Word D = Cipher::packWord(in, u);
+            Word A = C, B = D;
+            Cipher::decodeWords(S, A, B);
+            Cipher::unpackWord(out, 0, Word(A ^ prevA));
+            Cipher::unpackWord(out, u, Word(B ^ prevB));
+            prevA = C;
+            prevB = D;
+        }
+    }
+
+    // PKCS#5 style padding from RC5-CBC-Pad: 1 to 2u bytes, each holding the pad length
+    static constexpr size_t paddedSize(size_t bytes)
+    {
+        return (bytes / (2 * u) + 1) * 2 * u;
+    }
+};
+
+// CTR: block i of the keystream is E(iv + i), the iv read as one 2u-byte
+// little-endian counter (same byte order as packWord). Any byte length, and
+// firstBlock starts the keystream anywhere, so a stream can be entered at
+// any block without touching the ones before it
+template <uint8_t w, uint8_t r, uint8_t b>
+class RC5Ctr
+{
+private:
+    using Cipher = RC5<w, r, b>;
+
+public:
+    using Word = typename Cipher::Word;
+    using Schedule = typename Cipher::Schedule;
+    using Block = array<uint8_t, 2 * Cipher::u>;
+
+    static constexpr uint8_t u = Cipher::u;
+
+    // iv + index, carried through the whole block
+    static constexpr Block counter(const Block &iv, uint64_t index)
+    {
+        Block block = iv;
+        unsigned carry = 0;
+        for (size_t i = 0; i < block.size(); ++i)
+        {
+            const unsigned sum = block[i] + unsigned(uint8_t(index)) + carry;
+            block[i] = uint8_t(sum);
+            carry = sum >> 8;
+            index >>= 8;
+        }
+        return block;
+    }
+
+    // encryption and decryption are the same operation; in and out may alias
+    static constexpr void crypt(const Schedule &S, const Block &iv, uint64_t firstBlock, const uint8_t *in, uint8_t *out, size_t bytes)
+    {
+        RC5_METRIC_ADD(MetricBytesCtr, bytes);
+
+        for (uint64_t index = firstBlock; bytes; ++index)
+        {
+            const Block ctr = counter(iv, index);
+            Word A = Cipher::packWord(ctr, 0);
+            Word B = Cipher::packWord(ctr, u);
+            Cipher::encodeWords(S, A, B);
+
+            Block keystream{};
+            Cipher::unpackWord(keystream, 0, A);
+            Cipher::unpackWord(keystream, u, B);
+            const size_t n = min(bytes, keystream.size());
+            for (size_t i = 0; i < n; ++i)
+                out[i] = in[i] ^ keystream[i];
+            in += n;
+            out += n;
+            bytes -= n;
+        }
+    }
+};
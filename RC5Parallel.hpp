@@ -0,0 +1,139 @@
+#pragma once
+
+#include "RC5Modes.hpp"
+#include "RC5Simd.hpp"
+
+#include <thread>
+#include <vector>
+
+//////// MULTITHREADED BULK MODES
+
+// CTR and CBC decryption over large buffers: the buffer is split into
+// contiguous block-aligned chunks, one per thread, and every chunk goes
+// through RC5Simd. Same results as RC5Ctr::crypt and RC5Cbc::decrypt. CBC
+// encryption chains every block to the one before, so it stays with
+// RC5Cbc::encrypt on one thread
+template <uint8_t w, uint8_t r, uint8_t b>
+class RC5Parallel
+{
+private:
+    using Cipher = RC5<w, r, b>;
+    using Simd = RC5Simd<w, r, b>;
+    using Ctr = RC5Ctr<w, r, b>;
+
+public:
+    using Schedule = typename Cipher::Schedule;
+    using Block = typename Ctr::Block;
+
+    static constexpr uint8_t u = Cipher::u;
+
+    // a thread gets at least this many bytes, smaller jobs use fewer threads
+    static constexpr size_t minChunk = 1 << 16;
+
+    // same contract as RC5Ctr::crypt; in and out may alias
+    static void ctr(const Schedule &S, const Block &iv, uint64_t firstBlock, const uint8_t *in, uint8_t *out, size_t bytes,
+                    unsigned threads = thread::hardware_concurrency())
+    {
+        RC5_METRIC_ADD(MetricBytesCtr, bytes);
+
+        const size_t blocks = (bytes + 2 * u - 1) / (2 * u);
+        split(blocks, parts(blocks, threads), [&](size_t, size_t first, size_t count) {
+            const size_t offset = first * 2 * u;
+            ctrChunk(S, iv, firstBlock + first, in + offset, out + offset, min(count * 2 * u, bytes - offset));
+        });
+    }
+
+    // same contract as RC5Cbc::decrypt, except that in and out must either be
+    // the same buffer or not overlap at all
+    static void cbcDecrypt(const Schedule &S, const Block &iv, const uint8_t *in, uint8_t *out, size_t blocks,
+                           unsigned threads = thread::hardware_concurrency())
+    {
+        RC5_METRIC_ADD(MetricBytesCbc, blocks * 2 * u);
+
+        if (!blocks)
+            return;
+        // every chunk's first block chains to the block before it, or to the
+        // iv; taken before any chunk overwrites its input
+        const size_t chunks = parts(blocks, threads);
+        vector<Block> chained(chunks, iv);
+        for (size_t i = 1; i < chunks; ++i)
+            copy(in + (blocks * i / chunks - 1) * 2 * u, in + blocks * i / chunks * 2 * u, chained[i].begin());
+        split(blocks, chunks, [&](size_t part, size_t first, size_t count) {
+            Block previous = chained[part];
+            // a batch at a time through a local buffer, which the compiler
+            // knows aliases nothing, so the XOR loops vectorize
+            for (size_t done = 0; done < count; done += batchBlocks)
+            {
+                const size_t n = min(batchBlocks, count - done);
+                const uint8_t *ciphertext = in + (first + done) * 2 * u;
+                alignas(64) uint8_t data[batchBlocks * 2 * u];
+                Simd::decodeBlocks(S, ciphertext, data, n);
+                for (size_t i = 0; i < 2 * u; ++i)
+                    data[i] ^= previous[i];
+                for (size_t i = 2 * u; i < n * 2 * u; ++i)
+                    data[i] ^= ciphertext[i - 2 * u];
+                copy(ciphertext + (n - 1) * 2 * u, ciphertext + n * 2 * u, previous.begin());
+                memcpy(out + (first + done) * 2 * u, data, n * 2 * u);
+            }
+        });
+    }
+
+private:
+    // blocks per CBC decryption batch, 4 KiB
+    static constexpr size_t batchBlocks = 4096 / (2 * u);
+
+    // how many threads get a share of the blocks
+    static size_t parts(size_t blocks, unsigned threads)
+    {
+        return max<size_t>(1, min<size_t>(threads, blocks * 2 * u / minChunk));
+    }
+
+    // runs chunk(part, first, count) over contiguous ranges of the blocks,
+    // the last one on the calling thread
+    template <typename Chunk>
+    static void split(size_t blocks, size_t parts, Chunk &&chunk)
+    {
+        vector<thread> workers;
+        for (size_t i = 0; i + 1 < parts; ++i)
+            workers.emplace_back([&, i] { chunk(i, blocks * i / parts, blocks * (i + 1) / parts - blocks * i / parts); });
+        chunk(parts - 1, blocks * (parts - 1) / parts, blocks - blocks * (parts - 1) / parts);
+        for (thread &worker : workers)
+            worker.join();
+    }
+
+    // the counters are made in vector registers: lane i of A is the low word of
+    // the counter plus i, and a lane whose A wrapped carries into B
+    static void ctrChunk(const Schedule &S, const Block &iv, uint64_t index, const uint8_t *in, uint8_t *out, size_t bytes)
+    {
+        using Word = typename Cipher::Word;
+        using Vector = typename Simd::Vector;
+        constexpr size_t stride = Simd::lanes * 2 * u;
+
+        const Block ctr = Ctr::counter(iv, index);
+        Word low = Cipher::packWord(ctr, 0), high = Cipher::packWord(ctr, u);
+        const Vector step([](auto lane) { return Word(lane); });
+        while (bytes)
+        {
+            Vector A = low + step, B = high;
+            where(A < low, B) += 1;
+            Simd::encodeWords(S, A, B);
+
+            // through a local copy, which the compiler knows aliases nothing;
+            // the last one may use only part of the keystream
+            alignas(64) uint8_t keystream[stride], data[stride];
+            Simd::store(keystream, A, B);
+            const size_t n = min(bytes, stride);
+            memcpy(data, in, n);
+            memset(data + n, 0, stride - n);
+            for (size_t i = 0; i < stride; ++i)
+                data[i] ^= keystream[i];
+            memcpy(out, data, n);
+            in += n;
+            out += n;
+            bytes -= n;
+
+            high += Word(low + Simd::lanes) < low;
+            low += Simd::lanes;
+        }
+    }
+};
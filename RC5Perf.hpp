@@ -0,0 +1,253 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+using namespace std;
+
+//////// HARDWARE PERFORMANCE COUNTERS
+
+// counters read around a piece of code, user space only. Which ones exist
+// depends on the CPU and the kernel (virtual machines often expose none), so
+// every value comes with a valid flag instead of failing
+enum PerfEvent
+{
+    PerfCycles,
+    PerfInstructions,
+    PerfBranchMisses,
+    PerfL1dMisses,
+    PerfUopsRetired,
+    PerfEventCount
+};
+
+struct PerfSample
+{
+    array<uint64_t, PerfEventCount> values{};
+    array<bool, PerfEventCount> valid{};
+
+    double ipc() const
+    {
+        return valid[PerfCycles] && valid[PerfInstructions] && values[PerfCycles]
+                   ? double(values[PerfInstructions]) / values[PerfCycles]
+                   : 0;
+    }
+};
+
+// one perf_event_open group for the calling thread; the first event that
+// opens leads the group so all of them count over exactly the same interval
+class PerfCounters
+{
+public:
+    PerfCounters()
+    {
+        fds_.fill(-1);
+        for (int e = 0; e < PerfEventCount; ++e)
+        {
+            perf_event_attr attr{};
+            if (!describe(PerfEvent(e), attr))
+                continue;
+            attr.size = sizeof(attr);
+            attr.disabled = leader_ < 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID;
+            fds_[e] = syscall(SYS_perf_event_open, &attr, 0, -1, leader_, 0);
+            if (fds_[e] < 0)
+                continue;
+            if (leader_ < 0)
+                leader_ = fds_[e];
+            ioctl(fds_[e], PERF_EVENT_IOC_ID, &ids_[e]);
+        }
+    }
+
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    ~PerfCounters()
+    {
+        for (int fd : fds_)
+            if (fd >= 0)
+                close(fd);
+    }
+
+    bool available() const { return leader_ >= 0; }
+    bool available(PerfEvent e) const { return fds_[e] >= 0; }
+
+    void start()
+    {
+        if (leader_ < 0)
+            return;
+        ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+    PerfSample stop()
+    {
+        PerfSample sample;
+        if (leader_ < 0)
+            return sample;
+        ioctl(leader_, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+        // { nr, { value, id } * nr }
+        array<uint64_t, 1 + 2 * PerfEventCount> buffer{};
+        if (read(leader_, buffer.data(), sizeof(buffer)) <= 0)
+            return sample;
+        for (uint64_t i = 0; i < buffer[0]; ++i)
+            for (int e = 0; e < PerfEventCount; ++e)
+                if (fds_[e] >= 0 && ids_[e] == buffer[2 + 2 * i])
+                {
+                    sample.values[e] = buffer[1 + 2 * i];
+                    sample.valid[e] = true;
+                }
+        return sample;
+    }
+
+    static const char *name(PerfEvent e)
+    {
+        static constexpr const char *names[PerfEventCount] = {"cycles", "instructions", "branch_misses", "l1d_misses", "uops_retired"};
+        return names[e];
+    }
+
+private:
+    static bool describe(PerfEvent e, perf_event_attr &attr)
+    {
+        switch (e)
+        {
+        case PerfCycles:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            return true;
+        case PerfInstructions:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            return true;
+        case PerfBranchMisses:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            return true;
+        case PerfL1dMisses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+            return true;
+        case PerfUopsRetired:
+            attr.type = PERF_TYPE_RAW;
+            return uopsEvent(attr);
+        default:
+            return false;
+        }
+    }
+
+    // there is no generic uops event; RC5_PERF_UOPS overrides the raw event
+    // code, otherwise UOPS_RETIRED.SLOTS on Intel and RETIRED_OPS on AMD
+    static bool uopsEvent(perf_event_attr &attr)
+    {
+        if (const char *raw = getenv("RC5_PERF_UOPS"))
+        {
+            attr.config = strtoull(raw, nullptr, 0);
+            return true;
+        }
+#if defined(__x86_64__)
+        unsigned eax, ebx, ecx, edx;
+        if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx))
+            return false;
+        if (ebx == signature_INTEL_ebx)
+        {
+            attr.config = 0x02c2;
+            return true;
+        }
+        if (ebx == signature_AMD_ebx)
+        {
+            attr.config = 0xc1;
+            return true;
+        }
+#endif
+        return false;
+    }
+
+    array<int, PerfEventCount> fds_;
+    array<uint64_t, PerfEventCount> ids_{};
+    int leader_ = -1;
+};
+
+//////// RUNTIME HOOK
+
+// hot paths of the library that can be measured in place, see RC5_PERF_SCOPE
+enum PerfRegion
+{
+    PerfKeySetup,
+    PerfEncode,
+    PerfDecode,
+    PerfRegionCount
+};
+
+struct PerfTotals
+{
+    atomic<uint64_t> calls{0};
+    array<atomic<uint64_t>, PerfEventCount> values{};
+};
+
+inline array<PerfTotals, PerfRegionCount> &perfTotals()
+{
+    static array<PerfTotals, PerfRegionCount> totals;
+    return totals;
+}
+
+// counts one call of a region on the calling thread's counters and adds the
+// result to the process-wide totals; scopes must not nest
+class PerfScope
+{
+public:
+    explicit PerfScope(PerfRegion region) : region_(region)
+    {
+        counters().start();
+    }
+
+    ~PerfScope()
+    {
+        const PerfSample sample = counters().stop();
+        PerfTotals &totals = perfTotals()[region_];
+        totals.calls.fetch_add(1, memory_order_relaxed);
+        for (int e = 0; e < PerfEventCount; ++e)
+            totals.values[e].fetch_add(sample.values[e], memory_order_relaxed);
+    }
+
+    static PerfCounters &counters()
+    {
+        thread_local PerfCounters counters;
+        return counters;
+    }
+
+private:
+    PerfRegion region_;
+};
+
+// prints the accumulated totals of every region, with IPC
+inline void perfReport(ostream &out)
+{
+    static constexpr const char *regions[PerfRegionCount] = {"key_setup", "encode", "decode"};
+    for (int region = 0; region < PerfRegionCount; ++region)
+    {
+        const PerfTotals &totals = perfTotals()[region];
+        const uint64_t calls = totals.calls.load();
+        if (!calls)
+            continue;
+        out << regions[region] << ": calls " << calls;
+        for (int e = 0; e < PerfEventCount; ++e)
+            out << ", " << PerfCounters::name(PerfEvent(e)) << " " << totals.values[e].load();
+        const uint64_t cycles = totals.values[PerfCycles].load();
+        out << ", ipc " << fixed << setprecision(2) << (cycles ? double(totals.values[PerfInstructions].load()) / cycles : 0.0) << "\n";
+    }
+}
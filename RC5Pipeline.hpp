@@ -0,0 +1,601 @@
+#pragma once
+
+#include "RC5.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+//////// ASYNCHRONOUS FILE PIPELINE
+
+// moves a byte range of one file to another through a transform, a chunk at
+// a time: several reads and writes are in flight while worker threads
+// transform the chunks that have arrived, so I/O and computation overlap.
+// Uses io_uring with registered buffers, driven through the raw system calls,
+// and falls back to a reader thread and a writer thread doing pread/pwrite
+// when the kernel has no io_uring or refuses it (seccomp, memlock limits).
+// Keeps books on how long I/O was in flight, how long a transform ran, and
+// how long both happened at once
+class RC5Pipeline
+{
+public:
+    // transforms a chunk in place; offset is where it starts in the range
+    using Transform = function<void(uint8_t *data, size_t bytes, uint64_t offset)>;
+
+    struct Options
+    {
+        size_t chunkBytes = 1 << 20; // every chunk but the last is this long
+        unsigned depth = 16;         // chunks in memory at once
+        unsigned workers = thread::hardware_concurrency();
+        bool uring = true; // false goes straight to pread/pwrite
+    };
+
+    struct Stats
+    {
+        bool uring = false; // io_uring was used
+        uint64_t bytes = 0;
+        double seconds = 0;
+        double ioSeconds = 0;      // with a read or write in flight
+        double computeSeconds = 0; // with a transform running
+        double overlapSeconds = 0; // with both
+    };
+
+    explicit RC5Pipeline(const Options &options) : options_(options)
+    {
+        if (!options_.chunkBytes || !options_.depth)
+            throw invalid_argument("RC5Pipeline: empty chunks or no depth");
+        options_.workers = max(1u, options_.workers);
+        size_ = options_.chunkBytes * options_.depth;
+        void *buffers = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (buffers == MAP_FAILED)
+            throw system_error(errno, generic_category(), "cannot allocate pipeline buffers");
+        buffers_ = static_cast<uint8_t *>(buffers);
+        madvise(buffers_, size_, MADV_HUGEPAGE);
+    }
+
+    RC5Pipeline(const RC5Pipeline &) = delete;
+    RC5Pipeline &operator=(const RC5Pipeline &) = delete;
+
+    ~RC5Pipeline()
+    {
+        munmap(buffers_, size_);
+    }
+
+    // bytes from in at inOffset to out at outOffset; throws system_error on
+    // an I/O error or a short input, and passes on what transform throws
+    Stats run(int in, uint64_t inOffset, int out, uint64_t outOffset, uint64_t bytes, const Transform &transform)
+    {
+        Stats stats;
+        stats.bytes = bytes;
+        activity_.reset();
+        const auto begin = Clock::now();
+        if (bytes)
+        {
+            const Range range{in, inOffset, out, outOffset, bytes};
+            stats.uring = options_.uring && runUring(range, transform);
+            if (!stats.uring)
+                runThreads(range, transform);
+        }
+        activity_.change(0, 0);
+        stats.seconds = chrono::duration<double>(Clock::now() - begin).count();
+        stats.ioSeconds = activity_.ioSeconds;
+        stats.computeSeconds = activity_.computeSeconds;
+        stats.overlapSeconds = activity_.overlapSeconds;
+        return stats;
+    }
+
+private:
+    using Clock = chrono::steady_clock;
+
+    struct Range
+    {
+        int in;
+        uint64_t inOffset;
+        int out;
+        uint64_t outOffset;
+        uint64_t bytes;
+    };
+
+    // a chunk in a buffer and how much of its current read or write is done
+    struct Chunk
+    {
+        uint64_t offset = 0;
+        size_t bytes = 0;
+        size_t done = 0;
+    };
+
+    // I/O operations in flight and transforms running, integrated over time
+    struct Activity
+    {
+        mutex lock;
+        Clock::time_point last;
+        int io = 0, compute = 0;
+        double ioSeconds = 0, computeSeconds = 0, overlapSeconds = 0;
+
+        void reset()
+        {
+            last = Clock::now();
+            io = compute = 0;
+            ioSeconds = computeSeconds = overlapSeconds = 0;
+        }
+
+        void change(int ioDelta, int computeDelta)
+        {
+            lock_guard<mutex> guard(lock);
+            const auto now = Clock::now();
+            const double elapsed = chrono::duration<double>(now - last).count();
+            ioSeconds += io > 0 ? elapsed : 0;
+            computeSeconds += compute > 0 ? elapsed : 0;
+            overlapSeconds += io > 0 && compute > 0 ? elapsed : 0;
+            io += ioDelta;
+            compute += computeDelta;
+            last = now;
+        }
+    };
+
+    // buffer indices handed between threads; pop waits, and returns false
+    // once the queue is closed and empty or aborted
+    class Queue
+    {
+    public:
+        void push(unsigned index)
+        {
+            {
+                lock_guard<mutex> guard(lock_);
+                items_.push_back(index);
+            }
+            ready_.notify_one();
+        }
+
+        bool pop(unsigned &index)
+        {
+            unique_lock<mutex> guard(lock_);
+            ready_.wait(guard, [&] { return !items_.empty() || closed_; });
+            if (items_.empty() || aborted_)
+                return false;
+            index = items_.front();
+            items_.pop_front();
+            return true;
+        }
+
+        bool tryPop(unsigned &index)
+        {
+            lock_guard<mutex> guard(lock_);
+            if (items_.empty())
+                return false;
+            index = items_.front();
+            items_.pop_front();
+            return true;
+        }
+
+        void close(bool abort = false)
+        {
+            {
+                lock_guard<mutex> guard(lock_);
+                closed_ = true;
+                aborted_ = aborted_ || abort;
+            }
+            ready_.notify_all();
+        }
+
+    private:
+        mutex lock_;
+        condition_variable ready_;
+        deque<unsigned> items_;
+        bool closed_ = false, aborted_ = false;
+    };
+
+    // the rings of one io_uring instance, and an eventfd the workers wake it with
+    class Ring
+    {
+    public:
+        ~Ring()
+        {
+            // the kernel tears a ring down asynchronously, and a read still in
+            // flight would land in buffers the next run may be using, so
+            // everything submitted completes first; the eventfd poll
+            // completes once the eventfd is written
+            if (fd >= 0 && inflight_)
+            {
+                wake(event);
+                while (inflight_)
+                {
+                    if (syscall(__NR_io_uring_enter, fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR)
+                        break;
+                    reap([](uint64_t, int) {});
+                }
+            }
+            if (fd >= 0)
+                close(fd);
+            for (const auto &[address, length] : maps_)
+                munmap(address, length);
+            if (event >= 0)
+                close(event);
+        }
+
+        // false if the kernel has no io_uring for us
+        bool open(unsigned entries)
+        {
+            io_uring_params params{};
+            fd = int(syscall(__NR_io_uring_setup, entries, &params));
+            if (fd < 0)
+                return false;
+            const size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            const size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            const bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+            uint8_t *sq = map(single ? max(sqSize, cqSize) : sqSize, IORING_OFF_SQ_RING);
+            uint8_t *cq = single ? sq : map(cqSize, IORING_OFF_CQ_RING);
+            sqes_ = reinterpret_cast<io_uring_sqe *>(map(params.sq_entries * sizeof(io_uring_sqe), IORING_OFF_SQES));
+            if (!sq || !cq || !sqes_)
+                return false;
+
+            sqTail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+            sqMask_ = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+            sqArray_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+            cqHead_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+            cqTail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+            cqMask_ = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+            cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+            event = eventfd(0, EFD_CLOEXEC);
+            return event >= 0;
+        }
+
+        bool registerBuffers(const vector<iovec> &buffers)
+        {
+            return syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, buffers.data(), buffers.size()) == 0;
+        }
+
+        // the next submission entry, cleared; the ring has room for every
+        // operation the pipeline can have in flight
+        io_uring_sqe &next()
+        {
+            const unsigned tail = *sqTail_ + pending_++;
+            io_uring_sqe &sqe = sqes_[tail & sqMask_];
+            sqe = {};
+            sqArray_[tail & sqMask_] = tail & sqMask_;
+            return sqe;
+        }
+
+        // submits what next() handed out and waits for at least one completion
+        void submitAndWait()
+        {
+            atomic_ref<unsigned>(*sqTail_).store(*sqTail_ + pending_, memory_order_release);
+            inflight_ += pending_;
+            while (syscall(__NR_io_uring_enter, fd, pending_, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0)
+                if (errno != EINTR)
+                    throw system_error(errno, generic_category(), "io_uring_enter");
+            pending_ = 0;
+        }
+
+        template <typename Complete>
+        void reap(Complete &&complete)
+        {
+            unsigned head = *cqHead_;
+            const unsigned tail = atomic_ref<unsigned>(*cqTail_).load(memory_order_acquire);
+            for (; head != tail; ++head)
+            {
+                const io_uring_cqe cqe = cqes_[head & cqMask_];
+                atomic_ref<unsigned>(*cqHead_).store(head + 1, memory_order_release);
+                --inflight_;
+                complete(cqe.user_data, cqe.res);
+            }
+        }
+
+        int fd = -1;
+        int event = -1;
+
+    private:
+        uint8_t *map(size_t length, off_t offset)
+        {
+            void *address = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+            if (address == MAP_FAILED)
+                return nullptr;
+            maps_.push_back({address, length});
+            return static_cast<uint8_t *>(address);
+        }
+
+        vector<pair<void *, size_t>> maps_;
+        io_uring_sqe *sqes_ = nullptr;
+        unsigned *sqTail_ = nullptr, *sqArray_ = nullptr, sqMask_ = 0;
+        unsigned inflight_ = 0; // submitted and not yet reaped
+        unsigned *cqHead_ = nullptr, *cqTail_ = nullptr, cqMask_ = 0;
+        io_uring_cqe *cqes_ = nullptr;
+        unsigned pending_ = 0;
+    };
+
+    // user_data of a completion: the buffer index and what it was for
+    enum Operation : uint64_t
+    {
+        Read,
+        Write,
+        Wake
+    };
+
+    uint8_t *buffer(unsigned index) const
+    {
+        return buffers_ + size_t(index) * options_.chunkBytes;
+    }
+
+    // one worker: transforms the chunks from work until it closes and hands
+    // them to done, bumping event if there is one; stops at the first
+    // exception after passing it to fail
+    void transformChunks(const Transform &transform, const vector<Chunk> &chunks, Queue &work, Queue &done, int event,
+                         const function<void()> &fail)
+    {
+        for (unsigned index; work.pop(index);)
+        {
+            activity_.change(0, 1);
+            try
+            {
+                transform(buffer(index), chunks[index].bytes, chunks[index].offset);
+            }
+            catch (...)
+            {
+                activity_.change(0, -1);
+                fail();
+                return;
+            }
+            activity_.change(0, -1);
+            done.push(index);
+            wake(event);
+        }
+    }
+
+    static void wake(int event)
+    {
+        const uint64_t one = 1;
+        if (event >= 0)
+        {
+            [[maybe_unused]] const ssize_t n = write(event, &one, sizeof(one));
+        }
+    }
+
+    bool runUring(const Range &range, const Transform &transform)
+    {
+        Ring ring;
+        // a read or write per buffer and the eventfd poll
+        if (!ring.open(2 * options_.depth + 2))
+            return false;
+        vector<iovec> iovecs(options_.depth);
+        for (unsigned i = 0; i < options_.depth; ++i)
+            iovecs[i] = {buffer(i), options_.chunkBytes};
+        if (!ring.registerBuffers(iovecs))
+            return false;
+
+        vector<Chunk> chunks(options_.depth);
+        vector<unsigned> free;
+        for (unsigned i = options_.depth; i-- > 0;)
+            free.push_back(i);
+        Queue work, done;
+        exception_ptr error;
+        mutex errorLock;
+        const auto fail = [&] {
+            {
+                lock_guard<mutex> guard(errorLock);
+                if (!error)
+                    error = current_exception();
+            }
+            work.close(true);
+            wake(ring.event);
+        };
+        const auto failed = [&] {
+            lock_guard<mutex> guard(errorLock);
+            return error;
+        };
+        vector<thread> workers;
+        for (unsigned i = 0; i < options_.workers; ++i)
+            workers.emplace_back([&] { transformChunks(transform, chunks, work, done, ring.event, fail); });
+
+        // a poll rather than a read of the eventfd: IORING_OP_READ came in
+        // 5.6, while polls and fixed buffers are there since 5.1
+        const auto rearm = [&] {
+            io_uring_sqe &sqe = ring.next();
+            sqe.opcode = IORING_OP_POLL_ADD;
+            sqe.fd = ring.event;
+            sqe.poll_events = POLLIN;
+            sqe.user_data = Wake;
+        };
+        // the rest of chunk index's current read or write
+        const auto transfer = [&](unsigned index, Operation operation) {
+            const Chunk &chunk = chunks[index];
+            io_uring_sqe &sqe = ring.next();
+            sqe.opcode = operation == Read ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+            sqe.fd = operation == Read ? range.in : range.out;
+            sqe.off = (operation == Read ? range.inOffset : range.outOffset) + chunk.offset + chunk.done;
+            sqe.addr = uint64_t(buffer(index) + chunk.done);
+            sqe.len = chunk.bytes - chunk.done;
+            sqe.buf_index = index;
+            sqe.user_data = uint64_t(index) << 2 | operation;
+        };
+
+        try
+        {
+            rearm();
+            uint64_t next = 0, written = 0;
+            while (written < range.bytes)
+            {
+                while (!free.empty() && next < range.bytes)
+                {
+                    const unsigned index = free.back();
+                    free.pop_back();
+                    chunks[index] = {next, size_t(min<uint64_t>(options_.chunkBytes, range.bytes - next)), 0};
+                    next += chunks[index].bytes;
+                    activity_.change(1, 0);
+                    transfer(index, Read);
+                }
+                ring.submitAndWait();
+                ring.reap([&](uint64_t data, int result) {
+                    const unsigned index = unsigned(data >> 2);
+                    const Operation operation = Operation(data & 3);
+                    if (operation == Wake)
+                    {
+                        uint64_t wakes;
+                        if (result < 0)
+                            throw system_error(-result, generic_category(), "cannot poll eventfd");
+                        if (read(ring.event, &wakes, sizeof(wakes)) != sizeof(wakes))
+                            throw system_error(errno, generic_category(), "cannot read eventfd");
+                        if (const exception_ptr e = failed())
+                            rethrow_exception(e);
+                        rearm();
+                        for (unsigned ready; done.tryPop(ready);)
+                        {
+                            chunks[ready].done = 0;
+                            activity_.change(1, 0);
+                            transfer(ready, Write);
+                        }
+                        return;
+                    }
+
+                    Chunk &chunk = chunks[index];
+                    if (result <= 0)
+                        throw system_error(result ? -result : EIO, generic_category(), operation == Read ? "cannot read input" : "cannot write output");
+                    chunk.done += result;
+                    if (chunk.done < chunk.bytes)
+                    {
+                        transfer(index, operation);
+                        return;
+                    }
+                    activity_.change(-1, 0);
+                    if (operation == Read)
+                    {
+                        work.push(index);
+                    }
+                    else
+                    {
+                        written += chunk.bytes;
+                        free.push_back(index);
+                    }
+                });
+            }
+        }
+        catch (...)
+        {
+            work.close(true);
+            for (thread &worker : workers)
+                worker.join();
+            throw;
+        }
+        work.close();
+        for (thread &worker : workers)
+            worker.join();
+        return true;
+    }
+
+    void runThreads(const Range &range, const Transform &transform)
+    {
+        vector<Chunk> chunks(options_.depth);
+        Queue free, work, done;
+        for (unsigned i = 0; i < options_.depth; ++i)
+            free.push(i);
+        exception_ptr error;
+        mutex errorLock;
+        const auto fail = [&] {
+            {
+                lock_guard<mutex> guard(errorLock);
+                if (!error)
+                    error = current_exception();
+            }
+            free.close(true);
+            work.close(true);
+            done.close(true);
+        };
+
+        thread reader([&] {
+            try
+            {
+                unsigned index;
+                for (uint64_t next = 0; next < range.bytes && free.pop(index); next += chunks[index].bytes)
+                {
+                    Chunk &chunk = chunks[index];
+                    chunk = {next, size_t(min<uint64_t>(options_.chunkBytes, range.bytes - next)), 0};
+                    activity_.change(1, 0);
+                    while (chunk.done < chunk.bytes)
+                    {
+                        const ssize_t n = pread(range.in, buffer(index) + chunk.done, chunk.bytes - chunk.done,
+                                                range.inOffset + chunk.offset + chunk.done);
+                        if (n < 0 && errno == EINTR)
+                            continue;
+                        if (n <= 0)
+                            throw system_error(n ? errno : EIO, generic_category(), "cannot read input");
+                        chunk.done += n;
+                    }
+                    activity_.change(-1, 0);
+                    work.push(index);
+                }
+                work.close();
+            }
+            catch (...)
+            {
+                activity_.change(-1, 0);
+                fail();
+            }
+        });
+
+        // the last worker out closes done
+        atomic<unsigned> running{options_.workers};
+        vector<thread> workers;
+        for (unsigned i = 0; i < options_.workers; ++i)
+            workers.emplace_back([&] {
+                transformChunks(transform, chunks, work, done, -1, fail);
+                if (--running == 0)
+                    done.close();
+            });
+
+        // the calling thread writes
+        try
+        {
+            unsigned index;
+            for (uint64_t written = 0; written < range.bytes && done.pop(index);)
+            {
+                Chunk &chunk = chunks[index];
+                chunk.done = 0;
+                activity_.change(1, 0);
+                while (chunk.done < chunk.bytes)
+                {
+                    const ssize_t n = pwrite(range.out, buffer(index) + chunk.done, chunk.bytes - chunk.done,
+                                             range.outOffset + chunk.offset + chunk.done);
+                    if (n < 0 && errno == EINTR)
+                        continue;
+                    if (n <= 0)
+                        throw system_error(n ? errno : EIO, generic_category(), "cannot write output");
+                    chunk.done += n;
+                }
+                activity_.change(-1, 0);
+                written += chunk.bytes;
+                free.push(index);
+            }
+            free.close();
+        }
+        catch (...)
+        {
+            activity_.change(-1, 0);
+            fail();
+        }
+        reader.join();
+        for (thread &worker : workers)
+            worker.join();
+        if (error)
+            rethrow_exception(error);
+    }
+
+    Options options_;
+    uint8_t *buffers_ = nullptr;
+    size_t size_ = 0;
+    Activity activity_;
+};
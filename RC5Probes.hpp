@@ -0,0 +1,19 @@
+#pragma once
+
+//////// USDT PROBES
+
+// static tracepoints for bpftrace, SystemTap or perf, provider "rc5":
+//   key_setup_start(w, r, b)                 key_setup_done(w, r, b)
+//   encode_entry(bytes, w, r, specialized)   encode_return(bytes, w, r, specialized)
+//   decode_entry(bytes, w, r, specialized)   decode_return(bytes, w, r, specialized)
+// specialized is 1 for a pre-instantiated kernel and 0 for the generic engine.
+// An unattached probe is a single nop, so they are compiled in whenever
+// <sys/sdt.h> (header only, no library) is available; -DRC5_NO_USDT removes them
+#if !defined(RC5_NO_USDT) && __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define RC5_PROBE3(name, a1, a2, a3) DTRACE_PROBE3(rc5, name, a1, a2, a3)
+#define RC5_PROBE4(name, a1, a2, a3, a4) DTRACE_PROBE4(rc5, name, a1, a2, a3, a4)
+#else
+#define RC5_PROBE3(name, a1, a2, a3)
+#define RC5_PROBE4(name, a1, a2, a3, a4)
+#endif
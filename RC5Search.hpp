@@ -0,0 +1,141 @@
+#pragma once
+
+#include "RC5.hpp"
+
+//////// KNOWN-PLAINTEXT KEY SEARCH
+
+// walks a range of keys for the one that encrypts a known plaintext block to
+// a known ciphertext block, in the style of the RC5-72 challenge. A key range
+// counts keys as b-byte big-endian numbers, so the last key byte changes
+// fastest; as in RC5-72 that byte sits in the last word of L, the one the key
+// mixing reaches last
+template <uint8_t w, uint8_t r, uint8_t b>
+class RC5KeySearch
+{
+private:
+    using Cipher = RC5<w, r, b>;
+
+public:
+    using Word = typename Cipher::Word;
+    using Key = typename Cipher::Key;
+    using Schedule = typename Cipher::Schedule;
+    using Block = array<uint8_t, 2 * Cipher::u>;
+
+    static constexpr uint8_t u = Cipher::u;
+    static constexpr uint16_t t = Cipher::t;
+    // words in L, as in RC5::setupS
+    static constexpr size_t c = max<size_t>(1, (b + u - 1) / u);
+
+    struct Result
+    {
+        bool found = false;
+        Key key{};
+        uint64_t tried = 0; // keys tried, including the one found
+    };
+
+    RC5KeySearch(const Block &plaintext, const Block &ciphertext)
+        : plainA_(Cipher::packWord(plaintext, 0)), plainB_(Cipher::packWord(plaintext, u)),
+          cipherA_(Cipher::packWord(ciphertext, 0)), cipherB_(Cipher::packWord(ciphertext, u))
+    {
+    }
+
+    // tries up to count keys from start on and stops at the first match
+    Result search(const Key &start, uint64_t count) const
+    {
+        Result result;
+        Key key = start;
+        for (; result.tried < count; advance(key))
+        {
+            ++result.tried;
+            if (matches(key))
+            {
+                result.found = true;
+                result.key = key;
+                break;
+            }
+        }
+        return result;
+    }
+
+    // encrypts the plaintext under key, but only finishes the last half round
+    // when the first ciphertext word already matches: a wrong key is
+    // rejected after r - 1/2 rounds, and B is compared in about 1 of 2^w cases
+    bool matches(const Key &key) const
+    {
+        const Schedule S = setupS(key);
+        Word A = plainA_ + S[0];
+        Word B = plainB_ + S[1];
+        if constexpr (r > 0)
+        {
+            rounds(S, A, B, make_index_sequence<r - 1>{});
+            A = Cipher::left_shift(A ^ B, B) + S[2 * r];
+            if (A != cipherA_)
+                return false;
+            B = Cipher::left_shift(B ^ A, A) + S[2 * r + 1];
+            return B == cipherB_;
+        }
+        return A == cipherA_ && B == cipherB_;
+    }
+
+    // RC5::setupS for a search: the P/Q table is a constant and the 3 * max(t, c)
+    // mixing steps are unrolled, so i % t and j % c become fixed indices and S
+    // and L can live in registers
+    static Schedule setupS(const Key &K)
+    {
+        array<Word, c> L{};
+        for (int i = b - 1; i >= 0; --i)
+            L[i / u] = (L[i / u] << 8) + K[i];
+
+        Schedule S = initial;
+        Word A = 0, B = 0;
+        mix(S, L, A, B, make_index_sequence<3 * max<size_t>(t, c)>{});
+        return S;
+    }
+
+    // key + 1 as a big-endian number, wrapping around
+    static void advance(Key &key)
+    {
+        for (int i = b - 1; i >= 0 && ++key[i] == 0; --i)
+            ;
+    }
+
+    // key + n as a big-endian number, wrapping around
+    static Key advance(Key key, uint64_t n)
+    {
+        unsigned carry = 0;
+        for (int i = b - 1; i >= 0 && (n || carry); --i, n >>= 8)
+        {
+            const unsigned sum = key[i] + unsigned(uint8_t(n)) + carry;
+            key[i] = uint8_t(sum);
+            carry = sum >> 8;
+        }
+        return key;
+    }
+
+private:
+    static constexpr Schedule initial = [] {
+        Schedule S{};
+        S[0] = WordT<w>::P;
+        for (size_t i = 1; i < t; ++i)
+            S[i] = S[i - 1] + WordT<w>::Q;
+        return S;
+    }();
+
+    template <size_t... k>
+    static inline void mix(Schedule &S, array<Word, c> &L, Word &A, Word &B, index_sequence<k...>)
+    {
+        ((A = S[k % t] = Cipher::left_shift(S[k % t] + A + B, 3),
+          B = L[k % c] = Cipher::left_shift(L[k % c] + A + B, A + B)), ...);
+    }
+
+    // rounds 1 to r - 1; the last one is split up in matches
+    template <size_t... I>
+    static inline void rounds(const Schedule &S, Word &A, Word &B, index_sequence<I...>)
+    {
+        ((A = Cipher::left_shift(A ^ B, B) + S[2 * I + 2],
+          B = Cipher::left_shift(B ^ A, A) + S[2 * I + 3]), ...);
+    }
+
+    Word plainA_, plainB_;
+    Word cipherA_, cipherB_;
+};
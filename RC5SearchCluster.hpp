@@ -0,0 +1,541 @@
+#pragma once
+
+#include "RC5SearchRunner.hpp"
+
+#include <deque>
+#include <map>
+#include <optional>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+//////// MULTI-PROCESS KEY SEARCH OVER A UNIX-DOMAIN SOCKET
+
+// newline-terminated text messages over a connected stream socket
+class RC5SearchConnection
+{
+public:
+    RC5SearchConnection() = default;
+    explicit RC5SearchConnection(int fd) : fd_(fd) {}
+
+    RC5SearchConnection(RC5SearchConnection &&other) noexcept : fd_(exchange(other.fd_, -1)), buffer_(move(other.buffer_)) {}
+
+    RC5SearchConnection &operator=(RC5SearchConnection &&other) noexcept
+    {
+        swap(fd_, other.fd_);
+        swap(buffer_, other.buffer_);
+        return *this;
+    }
+
+    ~RC5SearchConnection()
+    {
+        if (fd_ >= 0)
+            close(fd_);
+    }
+
+    // throws system_error if nobody listens at path
+    static RC5SearchConnection connect(const string &path)
+    {
+        const sockaddr_un address = addressOf(path);
+        RC5SearchConnection connection(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+        if (connection.fd_ < 0 || ::connect(connection.fd_, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0)
+            throw system_error(errno, generic_category(), "cannot connect to " + path);
+        return connection;
+    }
+
+    static sockaddr_un addressOf(const string &path)
+    {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(address.sun_path))
+            throw invalid_argument("RC5SearchConnection: unusable socket path " + path);
+        path.copy(address.sun_path, path.size());
+        return address;
+    }
+
+    int fd() const
+    {
+        return fd_;
+    }
+
+    // false once the peer is gone
+    bool send(const string &message)
+    {
+        const string line = message + "\n";
+        for (size_t sent = 0; sent < line.size();)
+        {
+            const ssize_t n = ::send(fd_, line.data() + sent, line.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno != EINTR)
+                return false;
+            sent += max<ssize_t>(n, 0);
+        }
+        return true;
+    }
+
+    // waits for the next message; false once the peer is gone
+    bool receive(string &message)
+    {
+        while (!next(message))
+            if (!fill())
+                return false;
+        return true;
+    }
+
+    // one read of whatever has arrived, for use after poll; false once the
+    // peer is gone or sends a line longer than any message
+    bool fill()
+    {
+        char data[4096];
+        ssize_t n;
+        while ((n = recv(fd_, data, sizeof(data), 0)) < 0 && errno == EINTR)
+            ;
+        if (n <= 0 || buffer_.size() + n > maxLine)
+            return false;
+        buffer_.append(data, n);
+        return true;
+    }
+
+    // takes the next whole message out of what has been read
+    bool next(string &message)
+    {
+        const size_t end = buffer_.find('\n');
+        if (end == string::npos)
+            return false;
+        message = buffer_.substr(0, end);
+        buffer_.erase(0, end + 1);
+        return true;
+    }
+
+    // a message or the end of the connection is waiting
+    bool ready() const
+    {
+        pollfd event{fd_, POLLIN, 0};
+        return buffer_.find('\n') != string::npos || poll(&event, 1, 0) > 0;
+    }
+
+    // the key=value words of a message
+    static map<string, string> fields(const string &message)
+    {
+        map<string, string> fields;
+        istringstream words(message);
+        for (string word; words >> word;)
+            if (const size_t equals = word.find('='); equals != string::npos)
+                fields[word.substr(0, equals)] = word.substr(equals + 1);
+        return fields;
+    }
+
+private:
+    static constexpr size_t maxLine = 4096;
+
+    int fd_ = -1;
+    string buffer_;
+};
+
+// hands the units of an RC5SearchJob out to worker processes that connect to
+// a Unix-domain socket, one line per message:
+//
+//   on connect     coordinator: job w=32 r=12 b=8 plaintext=HEX ciphertext=HEX lease=MS
+//   worker: lease  coordinator: unit UNIT START COUNT | wait MS | finished
+//   worker: alive UNIT | done UNIT | found UNIT KEY
+//
+// A worker holds one unit at a time under a lease of leaseTimeout, which
+// alive renews. Units are handed out in order from a cursor, so the
+// coordinator keeps no list of them. A unit goes back to the front of a
+// queue that is served before the cursor when its worker disconnects, or
+// when the lease runs out, in which case the worker is dropped as hung. A
+// found key is checked before it is believed. Once the key is found or every
+// unit is done, the workers are told finished and disconnected; they look
+// for that between slices and drop their unit.
+template <uint8_t w, uint8_t r, uint8_t b>
+class RC5SearchCoordinator
+{
+public:
+    using Job = RC5SearchJob<w, r, b>;
+    using Key = typename Job::Search::Key;
+
+    struct Result
+    {
+        bool found = false;
+        Key key{};
+        bool complete = false; // every unit is searched
+        uint64_t reissued = 0; // units taken back from dead or hung workers
+    };
+
+    struct Progress
+    {
+        uint64_t units, unitsDone;
+        size_t workers, leased;
+        uint64_t reissued;
+    };
+
+    // listens at path, taking over the socket file of a coordinator that is
+    // gone; throws invalid_argument if one still listens there or the job is
+    // empty or runs past the last key
+    RC5SearchCoordinator(const Job &job, const string &path, chrono::milliseconds leaseTimeout = chrono::seconds(30))
+        : job_(checked(job)), path_(path), lease_(leaseTimeout), verify_(job.plaintext, job.ciphertext), done_(job.units())
+    {
+        const sockaddr_un address = RC5SearchConnection::addressOf(path);
+        try
+        {
+            RC5SearchConnection::connect(path);
+            throw invalid_argument("RC5SearchCoordinator: another coordinator listens at " + path);
+        }
+        catch (const system_error &)
+        {
+            unlink(path.c_str());
+        }
+        listen_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listen_ < 0 || bind(listen_, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0 ||
+            listen(listen_, SOMAXCONN) != 0)
+        {
+            const int error = errno;
+            if (listen_ >= 0)
+                close(listen_);
+            throw system_error(error, generic_category(), "cannot listen at " + path);
+        }
+    }
+
+    RC5SearchCoordinator(const RC5SearchCoordinator &) = delete;
+    RC5SearchCoordinator &operator=(const RC5SearchCoordinator &) = delete;
+
+    ~RC5SearchCoordinator()
+    {
+        close(listen_);
+        unlink(path_.c_str());
+    }
+
+    // serves workers until the key is found, every unit is done or stop() is
+    // called. report is called every reportInterval
+    template <typename Report>
+    Result run(Report &&report, chrono::milliseconds reportInterval = chrono::seconds(10))
+    {
+        stop_ = false;
+        auto lastReport = chrono::steady_clock::now();
+        while (!found_ && unitsDone_ < done_.size() && !stop_)
+        {
+            vector<pollfd> events{{listen_, POLLIN, 0}};
+            for (const Worker &worker : workers_)
+                events.push_back({worker.connection.fd(), POLLIN, 0});
+            // a short timeout, to notice stop() and expired leases
+            if (poll(events.data(), events.size(), 50) < 0 && errno != EINTR)
+                throw system_error(errno, generic_category(), "cannot poll workers");
+
+            const auto now = chrono::steady_clock::now();
+            for (size_t i = 0; i < workers_.size(); ++i)
+            {
+                Worker &worker = workers_[i];
+                if (events[i + 1].revents && (!worker.connection.fill() || !serve(worker, now)))
+                    drop(worker);
+                else if (worker.unit && now > worker.deadline)
+                    drop(worker);
+            }
+            erase_if(workers_, [](const Worker &worker) { return worker.connection.fd() < 0; });
+
+            if (events[0].revents & POLLIN)
+                accept(now);
+
+            if (now - lastReport >= reportInterval)
+            {
+                report(progress());
+                lastReport = now;
+            }
+        }
+
+        for (Worker &worker : workers_)
+            if (found_ || unitsDone_ == done_.size())
+                worker.connection.send("finished");
+        workers_.clear();
+        report(progress());
+
+        Result result;
+        result.found = found_;
+        result.key = key_;
+        result.complete = unitsDone_ == done_.size();
+        result.reissued = reissued_;
+        return result;
+    }
+
+    // ends run() at its next poll; safe from any thread
+    void stop()
+    {
+        stop_ = true;
+    }
+
+    Progress progress() const
+    {
+        const size_t leased = count_if(workers_.begin(), workers_.end(), [](const Worker &worker) { return worker.unit.has_value(); });
+        return Progress{done_.size(), unitsDone_, workers_.size(), leased, reissued_};
+    }
+
+private:
+    // before anything is sized by the job
+    static const Job &checked(const Job &job)
+    {
+        if (!job.count || !job.unitKeys)
+            throw invalid_argument("RC5SearchCoordinator: empty job");
+        if (!job.fits())
+            throw invalid_argument("RC5SearchCoordinator: the range runs past the last key");
+        return job;
+    }
+
+    using Runner = RC5SearchRunner<w, r, b>;
+    using Clock = chrono::steady_clock;
+
+    struct Worker
+    {
+        RC5SearchConnection connection;
+        optional<uint64_t> unit;
+        Clock::time_point deadline;
+    };
+
+    // how long a worker without a unit waits before it asks again
+    static constexpr auto retry = chrono::milliseconds(100);
+
+    void accept(Clock::time_point now)
+    {
+        RC5SearchConnection connection(accept4(listen_, nullptr, nullptr, SOCK_CLOEXEC));
+        ostringstream job;
+        job << "job w=" << int(w) << " r=" << int(r) << " b=" << int(b) << " plaintext=" << Runner::toHex(job_.plaintext.data(), job_.plaintext.size())
+            << " ciphertext=" << Runner::toHex(job_.ciphertext.data(), job_.ciphertext.size()) << " lease=" << lease_.count();
+        if (connection.fd() >= 0 && connection.send(job.str()))
+            workers_.push_back(Worker{move(connection), nullopt, now});
+    }
+
+    // answers the messages that have arrived; false if the worker is to go
+    bool serve(Worker &worker, Clock::time_point now)
+    {
+        for (string message; worker.connection.next(message);)
+        {
+            istringstream words(message);
+            string kind, hex;
+            uint64_t unit = 0;
+            words >> kind;
+            if (kind == "lease")
+            {
+                if (worker.unit)
+                    return false;
+                while (!queue_.empty() && done_[queue_.front()])
+                    queue_.pop_front();
+                if (found_ || unitsDone_ == done_.size())
+                {
+                    worker.connection.send("finished");
+                    return false;
+                }
+                if (!queue_.empty())
+                {
+                    unit = queue_.front();
+                    queue_.pop_front();
+                }
+                else if (next_ < done_.size())
+                {
+                    unit = next_++;
+                }
+                else
+                {
+                    if (!worker.connection.send("wait " + to_string(retry.count())))
+                        return false;
+                    continue;
+                }
+                worker.unit = unit;
+                worker.deadline = now + lease_;
+                const Key start = Job::Search::advance(job_.start, unit * job_.unitKeys);
+                const uint64_t keys = min(job_.unitKeys, job_.count - unit * job_.unitKeys);
+                if (!worker.connection.send("unit " + to_string(unit) + " " + Runner::toHex(start.data(), b) + " " + to_string(keys)))
+                    return false;
+                continue;
+            }
+
+            if (!(words >> unit) || !worker.unit || *worker.unit != unit)
+                return false;
+            if (kind == "alive")
+            {
+                worker.deadline = now + lease_;
+            }
+            else if (kind == "done")
+            {
+                finish(unit);
+                worker.unit.reset();
+            }
+            else if (kind == "found" && words >> hex && Runner::fromHex(hex, key_.data(), b) && verify_.matches(key_))
+            {
+                found_ = true;
+                finish(unit);
+                worker.unit.reset();
+            }
+            else
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void finish(uint64_t unit)
+    {
+        if (!done_[unit])
+        {
+            done_[unit] = true;
+            ++unitsDone_;
+        }
+    }
+
+    // disconnects a worker and puts its unit back in front
+    void drop(Worker &worker)
+    {
+        if (worker.unit && !done_[*worker.unit])
+        {
+            queue_.push_front(*worker.unit);
+            ++reissued_;
+        }
+        worker = Worker{};
+    }
+
+    const Job job_;
+    const string path_;
+    const chrono::milliseconds lease_;
+    const typename Job::Search verify_;
+    int listen_ = -1;
+
+    vector<Worker> workers_;
+    uint64_t next_ = 0;     // units from here on were never leased
+    deque<uint64_t> queue_; // units whose lease was lost, taken before next_
+    vector<bool> done_;
+    uint64_t unitsDone_ = 0;
+    uint64_t reissued_ = 0;
+    bool found_ = false;
+    Key key_{};
+
+    atomic<bool> stop_{false};
+};
+
+// searches the units an RC5SearchCoordinator hands out, on one thread with
+// RC5KeySearchSimd, until the coordinator says finished or goes away
+template <uint8_t w, uint8_t r, uint8_t b>
+class RC5SearchWorker
+{
+public:
+    using Job = RC5SearchJob<w, r, b>;
+    using Key = typename Job::Search::Key;
+
+    struct Result
+    {
+        bool finished = false; // false if the coordinator went away
+        uint64_t units = 0;
+        uint64_t keysSearched = 0;
+    };
+
+    // connects and takes the job; throws system_error if the coordinator
+    // cannot be reached and invalid_argument if its job has another w, r or b
+    explicit RC5SearchWorker(const string &path) : RC5SearchWorker(RC5SearchConnection::connect(path)) {}
+
+    // for a connection whose job message has been read already
+    RC5SearchWorker(RC5SearchConnection &&connection, const string &job)
+        : connection_(move(connection)), job_(parse(job)), engine_(job_.plaintext, job_.ciphertext)
+    {
+    }
+
+    Result run()
+    {
+        Result result;
+        string message;
+        // a failed send is noticed by receive, after any finished already sent
+        while (connection_.send("lease"), connection_.receive(message))
+        {
+            istringstream words(message);
+            string kind, hex;
+            uint64_t unit = 0, keys = 0;
+            words >> kind;
+            if (kind == "finished")
+            {
+                result.finished = true;
+                break;
+            }
+            if (kind == "wait" && words >> keys)
+            {
+                this_thread::sleep_for(chrono::milliseconds(keys));
+                continue;
+            }
+            Key start{};
+            if (kind != "unit" || !(words >> unit >> hex >> keys) || !Runner::fromHex(hex, start.data(), b))
+                break;
+
+            // slices as in RC5SearchRunner, renewing the lease in between
+            uint64_t searched = 0;
+            typename Job::Search::Result found;
+            auto renewed = chrono::steady_clock::now();
+            while (searched < keys && !found.found)
+            {
+                // finished, or the coordinator is gone
+                if (connection_.ready())
+                {
+                    result.finished = connection_.receive(message) && message == "finished";
+                    return result;
+                }
+                if (chrono::steady_clock::now() - renewed >= job_.lease / 3)
+                {
+                    if (!connection_.send("alive " + to_string(unit)))
+                        return result;
+                    renewed = chrono::steady_clock::now();
+                }
+                const uint64_t slice = min(slice_, keys - searched);
+                const auto begin = chrono::steady_clock::now();
+                found = engine_.search(Job::Search::advance(start, searched), slice);
+                searched += found.tried;
+                result.keysSearched += found.tried;
+
+                // a slice must stay well inside the lease even on a slow or busy machine
+                const auto took = chrono::steady_clock::now() - begin;
+                if (slice == slice_ && took < job_.lease / 8 && slice_ < maxSlice)
+                    slice_ *= 2;
+                else if (took > job_.lease / 4 && slice_ > 1)
+                    slice_ /= 2;
+            }
+            ++result.units;
+            if (!connection_.send(found.found ? "found " + to_string(unit) + " " + Runner::toHex(found.key.data(), b)
+                                              : "done " + to_string(unit)))
+                break;
+        }
+        return result;
+    }
+
+private:
+    using Runner = RC5SearchRunner<w, r, b>;
+
+    struct Terms
+    {
+        typename Job::Search::Block plaintext{}, ciphertext{};
+        chrono::milliseconds lease{};
+    };
+
+    static constexpr uint64_t maxSlice = 1 << 16;
+
+    explicit RC5SearchWorker(RC5SearchConnection &&connection) : RC5SearchWorker(move(connection), hello(connection)) {}
+
+    static string hello(RC5SearchConnection &connection)
+    {
+        string job;
+        if (!connection.receive(job))
+            throw system_error(ECONNRESET, generic_category(), "coordinator closed the connection");
+        return job;
+    }
+
+    static Terms parse(const string &job)
+    {
+        auto fields = RC5SearchConnection::fields(job);
+        Terms terms;
+        if (job.rfind("job ", 0) != 0 || fields["w"] != to_string(w) || fields["r"] != to_string(r) || fields["b"] != to_string(b) ||
+            !Runner::fromHex(fields["plaintext"], terms.plaintext.data(), terms.plaintext.size()) ||
+            !Runner::fromHex(fields["ciphertext"], terms.ciphertext.data(), terms.ciphertext.size()) ||
+            fields["lease"].find_first_not_of("0123456789") != string::npos || fields["lease"].empty())
+            throw invalid_argument("RC5SearchWorker: not a job for RC5-" + to_string(w) + "/" + to_string(r) + "/" + to_string(b) + ": " + job);
+        terms.lease = chrono::milliseconds(stoull(fields["lease"]));
+        return terms;
+    }
+
+    RC5SearchConnection connection_;
+    const Terms job_;
+    const RC5KeySearchSimd<w, r, b> engine_;
+    // keys between two looks at the connection, sized from how long a slice takes
+    uint64_t slice_ = 256;
+};
@@ -0,0 +1,424 @@
+#pragma once
+
+#include "RC5SearchSimd.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+//////// RESUMABLE MULTITHREADED KEY SEARCH
+
+// a key range of a known-plaintext search, split into work units of unitKeys keys
+template <uint8_t w, uint8_t r, uint8_t b>
+struct RC5SearchJob
+{
+    using Search = RC5KeySearch<w, r, b>;
+
+    typename Search::Key start{};
+    uint64_t count = 0;
+    uint64_t unitKeys = uint64_t(1) << 20;
+    typename Search::Block plaintext{};
+    typename Search::Block ciphertext{};
+
+    uint64_t units() const { return count / unitKeys + (count % unitKeys != 0); }
+
+    // false if the range runs past the last key, where it would wrap around
+    // to the first
+    bool fits() const
+    {
+        // below the last 8 bytes anything but all ones leaves 2^64 keys or more
+        constexpr size_t tail = min<size_t>(b, 8);
+        for (size_t i = 0; i < b - tail; ++i)
+            if (start[i] != 0xff)
+                return true;
+        uint64_t low = 0;
+        for (size_t i = b - tail; i < b; ++i)
+            low = low << 8 | start[i];
+        // the keys from start on are 2^(8 * tail) - low
+        if constexpr (tail == 8)
+            return !low || count <= ~low + 1;
+        else
+            return count <= (uint64_t(1) << 8 * tail) - low;
+    }
+};
+
+// runs an RC5SearchJob on several threads and checkpoints it in a journal, an
+// append-only text file:
+//
+//   rc5-search 1 w=32 r=12 b=16 start=HEX count=N unit=N plaintext=HEX ciphertext=HEX
+//   done UNIT
+//   found UNIT KEY
+//
+// Every unit is journaled once it is searched completely, and a later run
+// with the same journal skips exactly those units; a unit cut short by
+// stop() or a crash is searched again from its start. Completions are group
+// committed: the controlling thread appends all pending lines with a single
+// write and fdatasync every commitInterval. A torn last line is dropped.
+//
+// Every thread owns a range of units and takes them from its front; when it
+// runs dry it steals the back half of another thread's range, so no thread
+// idles while work is left and the queues stay a pair of numbers per thread
+// however large the keyspace. Units the journal already has are skipped as
+// they come up.
+template <uint8_t w, uint8_t r, uint8_t b>
+class RC5SearchRunner
+{
+public:
+    using Job = RC5SearchJob<w, r, b>;
+    using Key = typename Job::Search::Key;
+
+    struct Result
+    {
+        bool found = false;
+        Key key{};
+        bool complete = false;     // every unit is searched, including earlier runs
+        uint64_t keysSearched = 0; // by this run
+    };
+
+    struct Progress
+    {
+        uint64_t units, unitsDone;
+        uint64_t keysSearched; // by this run
+        double keysPerSecond;  // since the previous report
+    };
+
+    static constexpr auto commitInterval = chrono::milliseconds(200);
+
+    // opens or creates the journal; throws invalid_argument if the job is
+    // empty, runs past the last key or the journal belongs to another job,
+    // and system_error if it cannot be used
+    RC5SearchRunner(const Job &job, const string &journal, unsigned threads = thread::hardware_concurrency())
+        : job_(checked(job)), threads_(max(1u, threads)), engine_(job.plaintext, job.ciphertext), done_(job.units())
+    {
+        fd_ = open(journal.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd_ < 0)
+            throw system_error(errno, generic_category(), "cannot open journal " + journal);
+        replay(journal);
+    }
+
+    RC5SearchRunner(const RC5SearchRunner &) = delete;
+    RC5SearchRunner &operator=(const RC5SearchRunner &) = delete;
+
+    ~RC5SearchRunner()
+    {
+        close(fd_);
+    }
+
+    // searches every unit the journal does not have yet, until the key is
+    // found, the job is done or stop() is called. report is called from the
+    // calling thread every reportInterval
+    template <typename Report>
+    Result run(Report &&report, chrono::milliseconds reportInterval = chrono::seconds(10))
+    {
+        Result result;
+        if (found_)
+        {
+            result.found = true;
+            result.key = key_;
+            return result;
+        }
+
+        // contiguous slices of the units, one per thread
+        const uint64_t units = done_.size();
+        const auto begin = [&](unsigned i) { return units / threads_ * i + min<uint64_t>(i, units % threads_); };
+        vector<Queue> queues(threads_);
+        for (unsigned i = 0; i < threads_; ++i)
+        {
+            queues[i].first = begin(i);
+            queues[i].last = begin(i + 1);
+        }
+
+        stop_ = false;
+        keysSearched_ = 0;
+        running_ = threads_;
+        vector<thread> workers;
+        for (unsigned i = 0; i < threads_; ++i)
+            workers.emplace_back([this, &queues, i] { work(queues, i); });
+
+        // commits and reports until every worker is done
+        try
+        {
+            auto lastReport = chrono::steady_clock::now();
+            uint64_t lastKeys = 0;
+            for (bool finished = false; !finished;)
+            {
+                unique_lock<mutex> lock(mutex_);
+                finished = wake_.wait_for(lock, commitInterval, [&] { return running_ == 0; });
+                lock.unlock();
+                commit();
+
+                const auto now = chrono::steady_clock::now();
+                if (now - lastReport >= reportInterval || finished)
+                {
+                    const uint64_t keys = keysSearched_.load();
+                    const double seconds = chrono::duration<double>(now - lastReport).count();
+                    report(Progress{done_.size(), unitsDone(), keys, seconds > 0 ? (keys - lastKeys) / seconds : 0});
+                    lastReport = now;
+                    lastKeys = keys;
+                }
+            }
+        }
+        catch (...)
+        {
+            stop_ = true;
+            for (thread &worker : workers)
+                worker.join();
+            throw;
+        }
+        for (thread &worker : workers)
+            worker.join();
+        commit();
+
+        result.found = found_;
+        result.key = key_;
+        result.complete = unitsDone() == done_.size();
+        result.keysSearched = keysSearched_;
+        return result;
+    }
+
+    // asks the workers to stop at their next slice; safe from any thread
+    void stop()
+    {
+        stop_ = true;
+    }
+
+    uint64_t unitsDone() const
+    {
+        lock_guard<mutex> lock(mutex_);
+        return count(done_.begin(), done_.end(), true);
+    }
+
+    static string toHex(const uint8_t *bytes, size_t size)
+    {
+        static constexpr char digits[] = "0123456789abcdef";
+        string hex;
+        for (size_t i = 0; i < size; ++i)
+            hex += {digits[bytes[i] >> 4], digits[bytes[i] & 15]};
+        return hex;
+    }
+
+    // exactly size bytes or false
+    static bool fromHex(const string &hex, uint8_t *bytes, size_t size)
+    {
+        if (hex.size() != 2 * size)
+            return false;
+        const auto nibble = [](char digit) -> int {
+            if (digit >= '0' && digit <= '9')
+                return digit - '0';
+            if (digit >= 'a' && digit <= 'f')
+                return digit - 'a' + 10;
+            if (digit >= 'A' && digit <= 'F')
+                return digit - 'A' + 10;
+            return -1;
+        };
+        for (size_t i = 0; i < size; ++i)
+        {
+            const int high = nibble(hex[2 * i]), low = nibble(hex[2 * i + 1]);
+            if (high < 0 || low < 0)
+                return false;
+            bytes[i] = uint8_t(high << 4 | low);
+        }
+        return true;
+    }
+
+private:
+    // before anything is sized by the job
+    static const Job &checked(const Job &job)
+    {
+        if (!job.count || !job.unitKeys)
+            throw invalid_argument("RC5SearchRunner: empty job");
+        if (!job.fits())
+            throw invalid_argument("RC5SearchRunner: the range runs past the last key");
+        return job;
+    }
+
+    // the units [first, last) a thread has yet to take
+    struct alignas(64) Queue
+    {
+        mutex lock;
+        uint64_t first = 0, last = 0;
+    };
+
+    // keys searched between two looks at the stop flag
+    static constexpr uint64_t sliceKeys = 1 << 16;
+
+    string header() const
+    {
+        ostringstream line;
+        line << "rc5-search 1 w=" << int(w) << " r=" << int(r) << " b=" << int(b) << " start=" << toHex(job_.start.data(), b)
+             << " count=" << job_.count << " unit=" << job_.unitKeys << " plaintext=" << toHex(job_.plaintext.data(), job_.plaintext.size())
+             << " ciphertext=" << toHex(job_.ciphertext.data(), job_.ciphertext.size()) << "\n";
+        return line.str();
+    }
+
+    void replay(const string &journal)
+    {
+        string contents;
+        char buffer[1 << 16];
+        for (ssize_t n; (n = pread(fd_, buffer, sizeof(buffer), contents.size())) > 0;)
+            contents.append(buffer, n);
+
+        // a new journal, or one whose header write was cut short
+        if (contents.size() < header().size() && header().compare(0, contents.size(), contents) == 0)
+        {
+            if (!contents.empty() && ftruncate(fd_, 0) != 0)
+                throw system_error(errno, generic_category(), "cannot repair journal " + journal);
+            append(header());
+            // make the new directory entry durable as well
+            const size_t slash = journal.rfind('/');
+            const int dir = open(slash == string::npos ? "." : journal.substr(0, slash + 1).c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (dir >= 0)
+            {
+                fsync(dir);
+                close(dir);
+            }
+            return;
+        }
+
+        if (contents.compare(0, header().size(), header()) != 0)
+            throw invalid_argument("RC5SearchRunner: journal belongs to another job");
+        // only whole lines count; a crash can leave a partial one at the end,
+        // which is cut off so the next append does not extend it
+        const size_t whole = contents.rfind('\n') + 1;
+        if (whole < contents.size() && (ftruncate(fd_, whole) != 0 || fdatasync(fd_) != 0))
+            throw system_error(errno, generic_category(), "cannot repair journal " + journal);
+        istringstream lines(contents.substr(header().size(), whole - header().size()));
+        for (string line; getline(lines, line);)
+        {
+            istringstream fields(line);
+            string kind, hex;
+            uint64_t unit = 0;
+            fields >> kind >> unit;
+            if (!fields || unit >= done_.size())
+                continue;
+            if (kind == "done")
+                done_[unit] = true;
+            else if (kind == "found" && fields >> hex && fromHex(hex, key_.data(), b))
+                found_ = true;
+        }
+    }
+
+    void append(const string &lines)
+    {
+        for (size_t written = 0; written < lines.size();)
+        {
+            const ssize_t n = write(fd_, lines.data() + written, lines.size() - written);
+            if (n < 0 && errno != EINTR)
+                throw system_error(errno, generic_category(), "cannot write journal");
+            written += max<ssize_t>(n, 0);
+        }
+        if (fdatasync(fd_) != 0)
+            throw system_error(errno, generic_category(), "cannot sync journal");
+    }
+
+    void commit()
+    {
+        string lines;
+        {
+            lock_guard<mutex> lock(mutex_);
+            lines.swap(uncommitted_);
+        }
+        if (!lines.empty())
+            append(lines);
+    }
+
+    // the front of the own range, or else the back half of another one,
+    // rounded up so a last unit can be stolen too; one lock at a time
+    bool take(vector<Queue> &queues, unsigned self, uint64_t &unit)
+    {
+        Queue &own = queues[self];
+        {
+            lock_guard<mutex> lock(own.lock);
+            if (own.first < own.last)
+            {
+                unit = own.first++;
+                return true;
+            }
+        }
+        for (unsigned i = 1; i < queues.size(); ++i)
+        {
+            Queue &victim = queues[(self + i) % queues.size()];
+            uint64_t first, last;
+            {
+                lock_guard<mutex> lock(victim.lock);
+                if (victim.first == victim.last)
+                    continue;
+                last = victim.last;
+                first = last - (last - victim.first + 1) / 2;
+                victim.last = first;
+            }
+            lock_guard<mutex> lock(own.lock);
+            own.first = first + 1;
+            own.last = last;
+            unit = first;
+            return true;
+        }
+        return false;
+    }
+
+    void work(vector<Queue> &queues, unsigned self)
+    {
+        uint64_t unit;
+        while (!stop_ && take(queues, self, unit))
+        {
+            {
+                lock_guard<mutex> lock(mutex_);
+                if (done_[unit])
+                    continue;
+            }
+            const uint64_t first = unit * job_.unitKeys;
+            const uint64_t keys = min(job_.unitKeys, job_.count - first);
+            uint64_t searched = 0;
+            typename Job::Search::Result found;
+            while (searched < keys && !stop_ && !found.found)
+            {
+                const uint64_t slice = min(sliceKeys, keys - searched);
+                found = engine_.search(Job::Search::advance(job_.start, first + searched), slice);
+                searched += found.tried;
+                keysSearched_ += found.tried;
+            }
+
+            lock_guard<mutex> lock(mutex_);
+            if (found.found)
+            {
+                found_ = true;
+                key_ = found.key;
+                uncommitted_ += "found " + to_string(unit) + " " + toHex(key_.data(), b) + "\n";
+                stop_ = true;
+            }
+            else if (searched == keys)
+            {
+                done_[unit] = true;
+                uncommitted_ += "done " + to_string(unit) + "\n";
+            }
+        }
+        lock_guard<mutex> lock(mutex_);
+        if (--running_ == 0)
+            wake_.notify_all();
+    }
+
+    const Job job_;
+    const unsigned threads_;
+    const RC5KeySearchSimd<w, r, b> engine_;
+    int fd_ = -1;
+
+    mutable mutex mutex_;
+    condition_variable wake_;
+    vector<bool> done_;
+    bool found_ = false;
+    Key key_{};
+    string uncommitted_;
+    unsigned running_ = 0;
+
+    atomic<bool> stop_{false};
+    atomic<uint64_t> keysSearched_{0};
+};
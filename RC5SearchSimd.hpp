@@ -0,0 +1,167 @@
+#pragma once
+
+#include "RC5Search.hpp"
+#include "RC5Simd.hpp"
+
+//////// KEY SEARCH, ONE CANDIDATE PER VECTOR LANE
+
+// RC5KeySearch with native_simd<Word>::size() keys at a time. Keys are walked
+// in the same big-endian order, so a run of up to 256 keys differs only in
+// the last key byte, which is the top used byte of the last word of L. Per
+// run, everything the candidates share is done once in scalar code: packing
+// L, the P/Q table and the first c - 1 mixing steps, which never touch the
+// last L word. The lanes start from that state with one candidate each and
+// only differ from step c - 1 on
+template <uint8_t w, uint8_t r, uint8_t b>
+class RC5KeySearchSimd
+{
+    // a key byte to spread over the lanes
+    static_assert(b > 0);
+
+private:
+    using Cipher = RC5<w, r, b>;
+    using Search = RC5KeySearch<w, r, b>;
+    using Simd = RC5Simd<w, r, b>;
+
+public:
+    using Word = typename Cipher::Word;
+    using Key = typename Cipher::Key;
+    using Schedule = typename Cipher::Schedule;
+    using Block = typename Search::Block;
+    using Result = typename Search::Result;
+    using Vector = typename Simd::Vector;
+
+    static constexpr uint8_t u = Cipher::u;
+    static constexpr uint16_t t = Cipher::t;
+    static constexpr size_t c = Search::c;
+
+    // candidates per vector iteration
+    static constexpr size_t lanes = Vector::size();
+
+    RC5KeySearchSimd(const Block &plaintext, const Block &ciphertext)
+        : scalar_(plaintext, ciphertext), plainA_(Cipher::packWord(plaintext, 0)), plainB_(Cipher::packWord(plaintext, u)),
+          cipherA_(Cipher::packWord(ciphertext, 0))
+    {
+    }
+
+    // same contract as RC5KeySearch::search
+    Result search(const Key &start, uint64_t count) const
+    {
+        Result result;
+        Key key = start;
+        while (result.tried < count)
+        {
+            // the rest of this run of last-byte values
+            const uint64_t run = min<uint64_t>(256 - key[b - 1], count - result.tried);
+            const Prefix prefix = hoist(key);
+            for (uint64_t done = 0; done < run; done += lanes)
+            {
+                const size_t active = min<uint64_t>(lanes, run - done);
+                const int lane = firstMatch(prefix, uint8_t(key[b - 1] + done), active);
+                if (lane >= 0)
+                {
+                    result.found = true;
+                    result.key = key;
+                    result.key[b - 1] += done + lane;
+                    result.tried += done + lane + 1;
+                    return result;
+                }
+            }
+            result.tried += run;
+            key = Search::advance(key, run);
+        }
+        return result;
+    }
+
+private:
+    // the mixing state after step c - 2, common to all keys of a run
+    struct Prefix
+    {
+        Key key;
+        Schedule S;
+        array<Word, c> L;
+        Word A, B;
+    };
+
+    static Prefix hoist(const Key &key)
+    {
+        Prefix prefix{};
+        prefix.key = key;
+        for (int i = b - 2; i >= 0; --i)
+            prefix.L[i / u] = (prefix.L[i / u] << 8) + key[i];
+        prefix.S[0] = WordT<w>::P;
+        for (size_t i = 1; i < t; ++i)
+            prefix.S[i] = prefix.S[i - 1] + WordT<w>::Q;
+        for (size_t k = 0; k + 1 < c; ++k)
+        {
+            prefix.A = prefix.S[k % t] = Cipher::left_shift(prefix.S[k % t] + prefix.A + prefix.B, 3);
+            prefix.B = prefix.L[k] = Cipher::left_shift(prefix.L[k] + prefix.A + prefix.B, prefix.A + prefix.B);
+        }
+        return prefix;
+    }
+
+    // lane i tries the key of the run whose last byte is last + i; returns the
+    // first lane below active that holds the key, or -1
+    int firstMatch(const Prefix &prefix, uint8_t last, size_t active) const
+    {
+        // the last key byte is the top used byte of L[c - 1]
+        constexpr unsigned shift = 8 * ((b - 1) % u);
+        array<Vector, t> S;
+        for (size_t i = 0; i < t; ++i)
+            S[i] = prefix.S[i];
+        array<Vector, c> L;
+        for (size_t i = 0; i < c; ++i)
+            L[i] = prefix.L[i];
+        L[c - 1] += Vector([&](auto lane) { return Word(Word(uint8_t(last + lane)) << shift); });
+        Vector A = prefix.A, B = prefix.B;
+        mix(S, L, A, B, make_index_sequence<3 * max<size_t>(t, c) - (c - 1)>{});
+
+        A = plainA_ + S[0];
+        B = plainB_ + S[1];
+        if constexpr (r > 0)
+        {
+            rounds(S, A, B, make_index_sequence<r - 1>{});
+            A = Simd::left_shift(A ^ B, B) + S[2 * r];
+        }
+        const auto candidates = A == Vector(cipherA_);
+        if (stdx::none_of(candidates))
+            return -1;
+
+        // B only for the lanes that got this far, in scalar code
+        for (size_t lane = 0; lane < active; ++lane)
+            if (candidates[lane] && scalar_.matches(keyOf(prefix, last + lane)))
+                return lane;
+        return -1;
+    }
+
+    static Key keyOf(const Prefix &prefix, uint8_t last)
+    {
+        Key key = prefix.key;
+        key[b - 1] = last;
+        return key;
+    }
+
+    template <size_t... k>
+    static inline void mix(array<Vector, t> &S, array<Vector, c> &L, Vector &A, Vector &B, index_sequence<k...>)
+    {
+        ((A = S[(k + c - 1) % t] = rotate3(S[(k + c - 1) % t] + A + B),
+          B = L[(k + c - 1) % c] = Simd::left_shift(L[(k + c - 1) % c] + A + B, A + B)), ...);
+    }
+
+    // rounds 1 to r - 1
+    template <size_t... I>
+    static inline void rounds(const array<Vector, t> &S, Vector &A, Vector &B, index_sequence<I...>)
+    {
+        ((A = Simd::left_shift(A ^ B, B) + S[2 * I + 2],
+          B = Simd::left_shift(B ^ A, A) + S[2 * I + 3]), ...);
+    }
+
+    static inline Vector rotate3(const Vector &x)
+    {
+        return x << 3 | x >> (w - 3);
+    }
+
+    Search scalar_;
+    Word plainA_, plainB_;
+    Word cipherA_;
+};
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "RC5.hpp"
+
+#include <bit>
+#include <cstring>
+#include <experimental/simd>
+
+namespace stdx = std::experimental;
+
+//////// RC5 cipher over several blocks at once, portable SIMD
+
+// each vector lane holds one block, so native_simd<Word>::size() blocks go
+// through the rounds together. Sits between the scalar encodeBlocks loop and
+// hand-written kernels: no intrinsics, the compiler picks the instructions for
+// whatever target it builds for (requires libstdc++ 11+)
+template <uint8_t w, uint8_t r, uint8_t b>
+class RC5Simd
+{
+    // there is no vector lane type for w = 128
+    static_assert(w <= 64);
+
+private:
+    using Cipher = RC5<w, r, b>;
+
+public:
+    using Word = typename Cipher::Word;
+    using Schedule = typename Cipher::Schedule;
+    using Vector = stdx::native_simd<Word>;
+
+    static constexpr uint8_t u = Cipher::u;
+
+    // blocks processed per vector iteration
+    static constexpr size_t lanes = Vector::size();
+
+    // same contract as RC5::encodeBlocks, the tail shorter than a vector goes
+    // through the scalar loop
+    static void encodeBlocks(const Schedule &S, const uint8_t *in, uint8_t *out, size_t blocks)
+    {
+        for (; blocks >= lanes; blocks -= lanes, in += lanes * 2 * u, out += lanes * 2 * u)
+        {
+            Vector A, B;
+            load(in, A, B);
+            encodeWords(S, A, B);
+            store(out, A, B);
+        }
+        Cipher::encodeBlocks(S, in, out, blocks);
+    }
+
+    static void decodeBlocks(const Schedule &S, const uint8_t *in, uint8_t *out, size_t blocks)
+    {
+        for (; blocks >= lanes; blocks -= lanes, in += lanes * 2 * u, out += lanes * 2 * u)
+        {
+            Vector A, B;
+            load(in, A, B);
+            for (unsigned i = r; i > 0; --i)
+            {
+                B = right_shift(B - S[2 * i + 1], A) ^ A;
+                A = right_shift(A - S[2 * i], B) ^ B;
+            }
+            store(out, A - S[0], B - S[1]);
+        }
+        Cipher::decodeBlocks(S, in, out, blocks);
+    }
+
+    // RC5::encodeWords on every lane
+    static inline void encodeWords(const Schedule &S, Vector &A, Vector &B)
+    {
+        A += S[0];
+        B += S[1];
+        for (unsigned i = 1; i <= r; ++i)
+        {
+            A = left_shift(A ^ B, B) + S[2 * i];
+            B = left_shift(B ^ A, A) + S[2 * i + 1];
+        }
+    }
+
+    // rotations with a per-lane amount, as RC5::left_shift/right_shift
+    static inline Vector left_shift(const Vector &x, const Vector &y)
+    {
+        const Vector s = y & Word(w - 1);
+        return x << s | x >> ((Word(w) - s) & Word(w - 1));
+    }
+
+    static inline Vector right_shift(const Vector &x, const Vector &y)
+    {
+        const Vector s = y & Word(w - 1);
+        return x >> s | x << ((Word(w) - s) & Word(w - 1));
+    }
+
+    // splits lanes consecutive blocks into their A and B words. On a
+    // little-endian host the words are the bytes as they lie, so the blocks
+    // are copied in one piece and only deinterleaved
+    static inline void load(const uint8_t *in, Vector &A, Vector &B)
+    {
+        if constexpr (endian::native == endian::little)
+        {
+            Word words[2 * lanes];
+            memcpy(words, in, sizeof(words));
+            A = Vector([&](auto lane) { return words[2 * lane]; });
+            B = Vector([&](auto lane) { return words[2 * lane + 1]; });
+        }
+        else
+        {
+            A = Vector([&](auto lane) { return Cipher::packWord(in, lane * 2 * u); });
+            B = Vector([&](auto lane) { return Cipher::packWord(in, lane * 2 * u + u); });
+        }
+    }
+
+    static inline void store(uint8_t *out, const Vector &A, const Vector &B)
+    {
+        if constexpr (endian::native == endian::little)
+        {
+            Word words[2 * lanes];
+            for (size_t lane = 0; lane < lanes; ++lane)
+            {
+                words[2 * lane] = A[lane];
+                words[2 * lane + 1] = B[lane];
+            }
+            memcpy(out, words, sizeof(words));
+        }
+        else
+        {
+            for (size_t lane = 0; lane < lanes; ++lane)
+            {
+                Cipher::unpackWord(out, lane * 2 * u, Word(A[lane]));
+                Cipher::unpackWord(out, lane * 2 * u + u, Word(B[lane]));
+            }
+        }
+    }
+};
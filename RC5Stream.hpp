@@ -0,0 +1,281 @@
+#pragma once
+
+#include "RC5.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+//////// STREAMING PIPELINE
+
+// reads a stream, transforms it a chunk at a time and writes it out on three
+// threads: a reader, the caller transforming, and a writer. The chunks go
+// round a ring of page-aligned buffers; each stage owns one cursor and waits
+// on the one before it, so every handoff is a single-producer
+// single-consumer step without locks. Every chunk but the last is exactly
+// chunkBytes long however the input arrives, and the last one is empty only
+// for an empty input. When the output is a pipe the chunks are handed to it
+// with vmsplice instead of being copied by write: the pipe then holds our
+// pages, so a buffer given away is never written again and its slot gets
+// fresh pages. The input still goes through read, since every byte has to
+// pass through the transform in user space
+class RC5Stream
+{
+public:
+    // transforms a chunk in place and returns its new length, which may be
+    // up to tail bytes longer (padding)
+    using Transform = function<size_t(uint8_t *data, size_t bytes, bool last)>;
+
+    struct Options
+    {
+        size_t chunkBytes = 1 << 20;
+        size_t tail = 0;    // room after every chunk
+        unsigned depth = 4; // chunks in the ring, at least 2
+        bool splice = true; // vmsplice into a pipe
+    };
+
+    struct Stats
+    {
+        uint64_t in = 0, out = 0; // bytes read and written
+        double seconds = 0;
+        bool spliced = false;
+    };
+
+    explicit RC5Stream(const Options &options) : options_(options)
+    {
+        if (!options_.chunkBytes || options_.depth < 2)
+            throw invalid_argument("RC5Stream: empty chunks or fewer than two");
+        const size_t page = sysconf(_SC_PAGESIZE);
+        bufferBytes_ = (options_.chunkBytes + options_.tail + page - 1) / page * page;
+    }
+
+    // in to out until the end of in; throws system_error on an I/O error and
+    // passes on what transform throws, with the chunks before written out
+    Stats run(int in, int out, const Transform &transform)
+    {
+        Stats stats;
+        const auto begin = chrono::steady_clock::now();
+        struct stat info;
+        stats.spliced = options_.splice && fstat(out, &info) == 0 && S_ISFIFO(info.st_mode);
+        // a pipe as large as a chunk takes it in one go; only a hint
+        if (stats.spliced)
+            fcntl(out, F_SETPIPE_SZ, int(min<size_t>(options_.chunkBytes, 1 << 30)));
+
+        slots_.assign(options_.depth, {});
+        filled_ = transformed_ = written_ = 0;
+        error_ = nullptr;
+        try
+        {
+            for (Slot &slot : slots_)
+                slot.data = allocate();
+        }
+        catch (...)
+        {
+            release();
+            throw;
+        }
+
+        thread reader([&] { guard([&] { read(in, stats.in); }); });
+        thread writer([&] { guard([&] { write(out, stats.spliced, stats.out); }); });
+        guard([&] {
+            for (uint64_t i = 0; await(filled_, i); ++i)
+            {
+                // the slot is not ours once the cursor has moved on
+                Slot &slot = slots_[i % options_.depth];
+                const bool last = slot.last;
+                slot.bytes = transform(slot.data, slot.bytes, last);
+                advance(transformed_);
+                if (last)
+                    break;
+            }
+        });
+        reader.join();
+        writer.join();
+        release();
+        if (error_)
+            rethrow_exception(error_);
+        stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+        return stats;
+    }
+
+private:
+    // or'ed into every cursor when a stage fails, which wakes the others
+    static constexpr uint64_t aborted = uint64_t(1) << 63;
+
+    struct Slot
+    {
+        uint8_t *data = nullptr;
+        size_t bytes = 0;
+        bool last = false;
+    };
+
+    // true once cursor has passed index, false if the run was aborted
+    static bool await(atomic<uint64_t> &cursor, uint64_t index)
+    {
+        for (uint64_t value = cursor.load(memory_order_acquire);; value = cursor.load(memory_order_acquire))
+        {
+            if (value & aborted)
+                return false;
+            if (value > index)
+                return true;
+            cursor.wait(value, memory_order_acquire);
+        }
+    }
+
+    static void advance(atomic<uint64_t> &cursor)
+    {
+        cursor.fetch_add(1, memory_order_release);
+        cursor.notify_all();
+    }
+
+    // runs a stage, and on an exception keeps the first one and stops the rest
+    template <typename Stage>
+    void guard(Stage &&stage)
+    {
+        try
+        {
+            stage();
+        }
+        catch (...)
+        {
+            {
+                lock_guard<mutex> lock(errorLock_);
+                if (!error_)
+                    error_ = current_exception();
+            }
+            for (atomic<uint64_t> *cursor : {&filled_, &transformed_, &written_})
+            {
+                cursor->fetch_or(aborted);
+                cursor->notify_all();
+            }
+        }
+    }
+
+    // slot index is free once the writer is done with what it held before
+    bool vacant(uint64_t index)
+    {
+        return index < options_.depth || await(written_, index - options_.depth);
+    }
+
+    // reads until the buffer is full or the input ends; the bytes read
+    static size_t fill(int in, uint8_t *data, size_t bytes, bool &end)
+    {
+        size_t done = 0;
+        while (done < bytes && !end)
+        {
+            const ssize_t n = ::read(in, data + done, bytes - done);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0)
+                throw system_error(errno, generic_category(), "cannot read input");
+            end = n == 0;
+            done += n;
+        }
+        return done;
+    }
+
+    void read(int in, uint64_t &total)
+    {
+        bool end = false;
+        size_t have = 0; // already in the slot being filled
+        for (uint64_t i = 0; vacant(i); ++i)
+        {
+            Slot &slot = slots_[i % options_.depth];
+            have += fill(in, slot.data + have, options_.chunkBytes - have, end);
+            total += have;
+            // a full chunk is the last one only if nothing follows, which
+            // takes a read into the next slot to know
+            size_t next = 0;
+            if (!end)
+            {
+                if (!vacant(i + 1))
+                    return;
+                Slot &following = slots_[(i + 1) % options_.depth];
+                while (!next && !end)
+                {
+                    const ssize_t n = ::read(in, following.data, options_.chunkBytes);
+                    if (n < 0 && errno != EINTR)
+                        throw system_error(errno, generic_category(), "cannot read input");
+                    end = n == 0;
+                    next = max<ssize_t>(n, 0);
+                }
+            }
+            slot.bytes = have;
+            slot.last = end;
+            advance(filled_);
+            if (end)
+                return;
+            have = next;
+        }
+    }
+
+    void write(int out, bool splice, uint64_t &total)
+    {
+        for (uint64_t i = 0; await(transformed_, i); ++i)
+        {
+            Slot &slot = slots_[i % options_.depth];
+            for (size_t done = 0; done < slot.bytes;)
+            {
+                ssize_t n;
+                if (splice)
+                {
+                    const iovec part{slot.data + done, slot.bytes - done};
+                    n = vmsplice(out, &part, 1, SPLICE_F_GIFT);
+                }
+                else
+                    n = ::write(out, slot.data + done, slot.bytes - done);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                    throw system_error(n ? errno : EIO, generic_category(), "cannot write output");
+                done += n;
+            }
+            total += slot.bytes;
+            // the pipe may still hold the pages; they are not ours to reuse
+            if (splice && slot.bytes)
+            {
+                munmap(slot.data, bufferBytes_);
+                slot.data = nullptr; // if allocate throws
+                slot.data = allocate();
+            }
+            const bool last = slot.last;
+            advance(written_);
+            if (last)
+                return;
+        }
+    }
+
+    uint8_t *allocate() const
+    {
+        void *data = mmap(nullptr, bufferBytes_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data == MAP_FAILED)
+            throw system_error(errno, generic_category(), "cannot allocate stream buffers");
+        return static_cast<uint8_t *>(data);
+    }
+
+    void release()
+    {
+        for (Slot &slot : slots_)
+            if (slot.data)
+                munmap(slot.data, bufferBytes_);
+        slots_.clear();
+    }
+
+    Options options_;
+    size_t bufferBytes_;
+    vector<Slot> slots_;
+    atomic<uint64_t> filled_{0}, transformed_{0}, written_{0};
+    exception_ptr error_;
+    mutex errorLock_;
+};
@@ -0,0 +1,212 @@
+#include "RC5Analysis.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <random>
+
+//////// REDUCED-ROUND ANALYSIS TOOL
+
+// rc5_analysis --rounds R [--samples N|2^K] [--delta HEX] [--target HEX] [--alpha HEX] [--beta HEX]
+//              [--word a|b] [--shift N] [--bits N] [--top N] [--key HEX] [--seed N] [--threads N]
+//
+// samples pairs of plaintexts under one RC5-32/R key with a 16-byte key (R from
+// 0 to 16) and prints the output-difference histogram, the probability of
+// the delta -> target differential and the bias of the alpha -> beta linear
+// approximation as JSON. Differences and masks are blocks of 8 bytes of hex,
+// in the byte order of the cipher. The key defaults to one drawn from the seed
+
+struct Options
+{
+    unsigned rounds = 0;
+    bool roundsGiven = false;
+    uint64_t samples = uint64_t(1) << 24;
+    string delta = "0000008000000000";
+    string target = "0000008000000000";
+    string alpha = "0000000000000000";
+    string beta = "0000000000000000";
+    bool wordB = false;
+    unsigned shift = 0;
+    unsigned bits = 16;
+    unsigned top = 16;
+    string key;
+    uint64_t seed = 1;
+    unsigned threads = thread::hardware_concurrency();
+};
+
+static Options options;
+
+string toHex(const uint8_t *bytes, size_t size)
+{
+    ostringstream hex;
+    for (size_t i = 0; i < size; ++i)
+        hex << std::hex << setw(2) << setfill('0') << int(bytes[i]);
+    return hex.str();
+}
+
+// exactly size bytes or false
+bool fromHex(const string &hex, uint8_t *bytes, size_t size)
+{
+    if (hex.size() != 2 * size || hex.find_first_not_of("0123456789abcdefABCDEF") != string::npos)
+        return false;
+    for (size_t i = 0; i < size; ++i)
+        bytes[i] = uint8_t(stoul(hex.substr(2 * i, 2), nullptr, 16));
+    return true;
+}
+
+// N or 2^K with K up to 63; throws out_of_range for any other K
+uint64_t count(const string &text)
+{
+    if (text.rfind("2^", 0) == 0)
+    {
+        const int exponent = stoi(text.substr(2));
+        if (exponent < 0 || exponent > 63)
+            throw out_of_range("2^K needs K in [0, 63]");
+        return uint64_t(1) << exponent;
+    }
+    return stoull(text);
+}
+
+template <uint8_t r>
+int analyse()
+{
+    using Analysis = RC5Differential<32, r, 16>;
+    using Cipher = RC5<32, r, 16>;
+
+    typename Analysis::Key key;
+    mt19937_64 rng(options.seed);
+    for (auto &byte : key)
+        byte = uint8_t(rng());
+    if (!options.key.empty() && !fromHex(options.key, key.data(), key.size()))
+    {
+        cerr << "rc5_analysis: the key is 16 bytes of hex\n";
+        return 2;
+    }
+
+    typename Analysis::Spec spec;
+    spec.wordB = options.wordB;
+    spec.shift = options.shift;
+    spec.bits = options.bits;
+    const auto words = [](const string &hex, typename Analysis::Words &out) {
+        array<uint8_t, 8> block;
+        if (!fromHex(hex, block.data(), block.size()))
+            return false;
+        out = {Cipher::packWord(block, 0), Cipher::packWord(block, 4)};
+        return true;
+    };
+    if (!words(options.delta, spec.delta) || !words(options.target, spec.target) || !words(options.alpha, spec.alpha) ||
+        !words(options.beta, spec.beta))
+    {
+        cerr << "rc5_analysis: differences and masks are 8 bytes of hex\n";
+        return 2;
+    }
+
+    const auto begin = chrono::steady_clock::now();
+    typename Analysis::Stats stats;
+    try
+    {
+        stats = Analysis::run(key, spec, options.samples, options.seed, options.threads);
+    }
+    catch (const exception &e)
+    {
+        cerr << "rc5_analysis: " << e.what() << "\n";
+        return 2;
+    }
+    const double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+    // the most frequent output differences, by count
+    vector<uint32_t> order(stats.histogram.size());
+    for (uint32_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    const size_t top = min<size_t>(options.top, order.size());
+    partial_sort(order.begin(), order.begin() + top, order.end(),
+                 [&](uint32_t x, uint32_t y) { return stats.histogram[x] > stats.histogram[y]; });
+
+    // a probability p as log2(p), -inf as null
+    const auto log2p = [&](uint64_t events) -> string {
+        if (!events)
+            return "null";
+        ostringstream out;
+        out << fixed << setprecision(3) << log2(double(events) / stats.samples);
+        return out.str();
+    };
+
+    cout << "{\n  \"w\": 32, \"r\": " << int(r) << ", \"b\": 16, \"key\": \"" << toHex(key.data(), key.size()) << "\", \"seed\": " << options.seed
+         << ",\n  \"samples\": " << stats.samples << ", \"threads\": " << options.threads << ", \"seconds\": " << setprecision(6) << seconds
+         << ", \"samples_per_second\": " << stats.samples / max(seconds, 1e-9) << ",\n  \"differential\": {\"delta\": \"" << options.delta
+         << "\", \"target\": \"" << options.target << "\", \"hits\": " << stats.hits << ", \"log2_probability\": " << log2p(stats.hits)
+         << "},\n  \"linear\": {\"alpha\": \"" << options.alpha << "\", \"beta\": \"" << options.beta << "\", \"agree\": " << stats.agree
+         << ", \"bias\": " << stats.bias() << "},\n  \"histogram\": {\"word\": \"" << (options.wordB ? "b" : "a") << "\", \"shift\": "
+         << options.shift << ", \"bits\": " << options.bits << ", \"top\": [\n";
+    for (size_t i = 0; i < top; ++i)
+        cout << "    {\"difference\": " << order[i] << ", \"count\": " << stats.histogram[order[i]] << ", \"log2_probability\": "
+             << log2p(stats.histogram[order[i]]) << "}" << (i + 1 < top ? "," : "") << "\n";
+    cout << "  ]}\n}\n";
+    return 0;
+}
+
+template <uint8_t... r>
+int analyse(unsigned rounds, integer_sequence<uint8_t, r...>)
+{
+    int status = 2;
+    ((rounds == r ? (status = analyse<r>(), true) : false) || ...);
+    return status;
+}
+
+int usage(const char *name)
+{
+    cerr << "usage: " << name << " --rounds R [--samples N|2^K] [--delta HEX] [--target HEX] [--alpha HEX] [--beta HEX]"
+         << " [--word a|b] [--shift N] [--bits N] [--top N] [--key HEX] [--seed N] [--threads N]\n";
+    return 2;
+}
+
+int main(int argc, char **argv)
+{
+    try
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const string arg = argv[i];
+            const bool value = i + 1 < argc;
+            if (arg == "--rounds" && value)
+            {
+                options.rounds = stoul(argv[++i]);
+                options.roundsGiven = true;
+            }
+            else if (arg == "--samples" && value)
+                options.samples = count(argv[++i]);
+            else if (arg == "--delta" && value)
+                options.delta = argv[++i];
+            else if (arg == "--target" && value)
+                options.target = argv[++i];
+            else if (arg == "--alpha" && value)
+                options.alpha = argv[++i];
+            else if (arg == "--beta" && value)
+                options.beta = argv[++i];
+            else if (arg == "--word" && value)
+                options.wordB = string(argv[++i]) == "b";
+            else if (arg == "--shift" && value)
+                options.shift = stoul(argv[++i]);
+            else if (arg == "--bits" && value)
+                options.bits = stoul(argv[++i]);
+            else if (arg == "--top" && value)
+                options.top = stoul(argv[++i]);
+            else if (arg == "--key" && value)
+                options.key = argv[++i];
+            else if (arg == "--seed" && value)
+                options.seed = stoull(argv[++i]);
+            else if (arg == "--threads" && value)
+                options.threads = max(1, stoi(argv[++i]));
+            else
+                return usage(argv[0]);
+        }
+    }
+    catch (const logic_error &)
+    {
+        // a number that is not one, or out of range (stoi and friends)
+        return usage(argv[0]);
+    }
+    if (!options.roundsGiven || options.rounds > 16)
+        return usage(argv[0]);
+
+    return analyse(options.rounds, make_integer_sequence<uint8_t, 17>{});
+}
@@ -0,0 +1,698 @@
+#include "RC5.hpp"
+#include "RC5Jit.hpp"
+#include "RC5Perf.hpp"
+#include "RC5Search.hpp"
+#include "RC5SearchSimd.hpp"
+#include "RC5Simd.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <string>
+
+#include <sched.h>
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+//////// BENCHMARK HARNESS
+
+// rc5_bench [--suite grid|latency|keys|search] [--cpu N] [--repeats N] [--filter TEXT] [--no-perf]
+//
+// the grid suite (default) runs every backend over the (w, r, b) grid in
+// three modes and prints JSON:
+//   latency  cycles per single-block call, each call depends on the previous one
+//   bulk     cycles per byte over a 64 KiB buffer
+//   setup    cycles per key expansion (or per JIT compilation)
+// plus, for the JIT, a derived breakeven row: the bytes after which its
+// compilation has paid off against the scalar kernel
+// every row carries the per-repeat samples, so runs can be compared statistically,
+// and, where perf_event_open works, hardware counters per unit plus IPC, which
+// tell rotate-port saturation (high uops, low IPC) apart from memory stalls
+//
+// the latency suite times every call on small messages (16 B to 4 KiB) and
+// reports percentiles of the per-call cycle histogram instead, see benchLatency
+//
+// the keys suite spreads small messages over many expanded keys and reports
+// cycles/byte against the size of the schedule working set, see benchKeys
+//
+// the search suite runs a known-plaintext key search on one core and reports
+// cycles and keys/s per candidate key, see benchSearch
+
+struct Options
+{
+    string suite = "grid";
+    int cpu = -1;
+    int repeats = 11;
+    string filter;
+    bool perf = true;
+};
+
+struct Result
+{
+    string kernel;
+    int w, r, b;
+    string mode;
+    string unit;
+    double value; // median of samples
+    vector<double> samples;
+    PerfSample counters; // summed over all repeats
+    double countersUnits;
+    size_t workingSet = 0; // bytes of expanded keys touched, keys suite only
+    double keysPerSecond = 0; // search suite only
+};
+
+// log-linear buckets in the style of HdrHistogram: values below 2^subBits
+// are exact, above that every power of two is split into 2^(subBits - 1)
+// buckets, so a recorded value is off by less than 2^-(subBits - 1)
+class LatencyHistogram
+{
+public:
+    static constexpr int subBits = 8;
+    static constexpr uint64_t half = 1 << (subBits - 1);
+
+    void record(uint64_t value)
+    {
+        ++counts_[index(value)];
+        ++total_;
+        max_ = max(max_, value);
+    }
+
+    uint64_t count() const { return total_; }
+    uint64_t maximum() const { return max_; }
+
+    // smallest bucket bound that covers at least p percent of the values
+    uint64_t percentile(double p) const
+    {
+        const uint64_t target = max<uint64_t>(1, ceil(p / 100 * total_));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts_.size(); ++i)
+            if ((seen += counts_[i]) >= target)
+                return min(upper(i), max_);
+        return max_;
+    }
+
+private:
+    static size_t index(uint64_t value)
+    {
+        if (value < 2 * half)
+            return value;
+        const int shift = 63 - __builtin_clzll(value) - (subBits - 1);
+        return shift * half + (value >> shift);
+    }
+
+    static uint64_t upper(size_t i)
+    {
+        if (i < 2 * half)
+            return i;
+        const int shift = i / half - 1;
+        return ((i - shift * half) << shift) + (uint64_t(1) << shift) - 1;
+    }
+
+    array<uint64_t, (66 - subBits) * half> counts_{};
+    uint64_t total_ = 0;
+    uint64_t max_ = 0;
+};
+
+// the percentiles reported for every histogram
+constexpr array<const char *, 5> percentileNames = {"p50", "p90", "p99", "p99.9", "p99.99"};
+constexpr array<double, 5> percentilePoints = {50, 90, 99, 99.9, 99.99};
+
+struct Histogram
+{
+    string kernel;
+    int w, r, b;
+    string message; // size in bytes or "mix"
+    LatencyHistogram cycles; // over all repeats
+    vector<array<uint64_t, 5>> samples; // the percentiles of every repeat
+};
+
+static Options options;
+static vector<Result> results;
+static vector<Histogram> histograms;
+static PerfCounters *counters;
+
+// cycle counter: TSC on x86-64, nanoseconds elsewhere
+inline uint64_t ticks()
+{
+#if defined(__x86_64__)
+    return __rdtsc();
+#else
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// keeps the optimizer from discarding benchmarked results
+template <typename T>
+inline void doNotOptimize(const T &value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+inline double median(vector<double> values)
+{
+    sort(values.begin(), values.end());
+    const size_t n = values.size();
+    return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+// times f() once for warm-up and then options.repeats times; each sample is
+// the tick count divided by the number of units (bytes, blocks, keys) f processed.
+// Returns false if the row was filtered out
+template <typename F>
+bool run(const string &kernel, int w, int r, int b, const string &mode, const string &unit, double units, F &&f)
+{
+    const string label = kernel + "/" + to_string(w) + "/" + to_string(r) + "/" + to_string(b) + "/" + mode;
+    if (!options.filter.empty() && label.find(options.filter) == string::npos)
+        return false;
+
+    f();
+    Result result{kernel, w, r, b, mode, unit, 0, {}, {}, units * options.repeats};
+    if (counters)
+        counters->start();
+    for (int i = 0; i < options.repeats; ++i)
+    {
+        const uint64_t start = ticks();
+        f();
+        result.samples.push_back((ticks() - start) / units);
+    }
+    if (counters)
+        result.counters = counters->stop();
+    result.value = median(result.samples);
+    results.push_back(move(result));
+    return true;
+}
+
+// deterministic key bytes, constexpr so RC5Fixed can take the same key
+template <uint8_t b>
+constexpr array<uint8_t, b> benchKey()
+{
+    array<uint8_t, b> key{};
+    for (size_t i = 0; i < b; ++i)
+        key[i] = uint8_t(i * 37 + 11);
+    return key;
+}
+
+//////// BACKENDS
+
+constexpr size_t bulkBytes = 64 * 1024;
+constexpr size_t latencyCalls = 1000;
+constexpr size_t setupKeys = 200;
+
+// runs one backend's block function in the latency and bulk modes
+template <uint8_t w, typename Encode>
+void runBlocks(const string &kernel, int r, int b, Encode &&encode)
+{
+    constexpr size_t blockSize = w / 4;
+    array<uint8_t, blockSize> block{};
+    run(kernel, w, r, b, "latency", "cycles/block", latencyCalls, [&] {
+        for (size_t i = 0; i < latencyCalls; ++i)
+            encode(block.data(), block.data(), 1);
+        doNotOptimize(block);
+    });
+
+    vector<uint8_t> data(bulkBytes, 0x5A);
+    run(kernel, w, r, b, "bulk", "cycles/byte", bulkBytes, [&] {
+        encode(data.data(), data.data(), bulkBytes / blockSize);
+        doNotOptimize(data[0]);
+    });
+}
+
+// the derived row jit/w/r/b/breakeven: bytes after which the JIT has paid
+// for its compilation against the scalar kernel, setup cycles over the
+// cycles per byte it saves, repeat by repeat. Left out when a row it is
+// derived from was filtered out, or the JIT is not faster in every repeat
+void breakEven(int w, int r, int b)
+{
+    const string label = "jit/" + to_string(w) + "/" + to_string(r) + "/" + to_string(b) + "/breakeven";
+    if (!options.filter.empty() && label.find(options.filter) == string::npos)
+        return;
+    const auto find = [&](const string &kernel, const string &mode) -> const Result * {
+        for (const Result &res : results)
+            if (res.kernel == kernel && res.w == w && res.r == r && res.b == b && res.mode == mode)
+                return &res;
+        return nullptr;
+    };
+    const Result *setup = find("jit", "setup"), *jit = find("jit", "bulk"), *scalar = find("scalar", "bulk");
+    if (!setup || !jit || !scalar)
+        return;
+
+    Result result{"jit", w, r, b, "breakeven", "bytes", 0, {}, {}, 0};
+    for (size_t i = 0; i < setup->samples.size(); ++i)
+    {
+        const double saved = scalar->samples[i] - jit->samples[i];
+        if (saved <= 0)
+        {
+            cerr << "rc5_bench: " << label << ": no break-even, the JIT is not faster than scalar\n";
+            return;
+        }
+        result.samples.push_back(setup->samples[i] / saved);
+    }
+    result.value = median(result.samples);
+    results.push_back(move(result));
+}
+
+template <uint8_t w, uint8_t r, uint8_t b>
+void benchConfig()
+{
+    using Cipher = RC5<w, r, b>;
+    static constexpr auto key = benchKey<b>();
+    const auto S = Cipher::setupS(key);
+
+    // generic scalar kernel over an expanded key
+    run("scalar", w, r, b, "setup", "cycles/key", setupKeys, [&] {
+        auto K = key;
+        for (size_t i = 0; i < setupKeys; ++i)
+        {
+            K[0] = uint8_t(i);
+            doNotOptimize(Cipher::setupS(K));
+        }
+    });
+    runBlocks<w>("scalar", r, b, [&](const uint8_t *in, uint8_t *out, size_t blocks) { Cipher::encodeBlocks(S, in, out, blocks); });
+
+    // the original one-shot API, expands the key on every call
+    array<uint8_t, 2 * Cipher::u> block{};
+    run("encode", w, r, b, "latency", "cycles/block", latencyCalls, [&] {
+        for (size_t i = 0; i < latencyCalls; ++i)
+            block = Cipher::encode(key, block);
+        doNotOptimize(block);
+    });
+
+    // key folded into the code at compile time
+    runBlocks<w>("fixed", r, b, [&](const uint8_t *in, uint8_t *out, size_t blocks) { RC5Fixed<w, r, key>::encodeBlocks(in, out, blocks); });
+
+    // runtime facade, construction includes key setup and kernel selection
+    run("cipher", w, r, b, "setup", "cycles/key", setupKeys, [&] {
+        for (size_t i = 0; i < setupKeys; ++i)
+            doNotOptimize(RC5Cipher(w, r, key.data(), b).specialized());
+    });
+    const RC5Cipher cipher(w, r, key.data(), b);
+    runBlocks<w>("cipher", r, b, [&](const uint8_t *in, uint8_t *out, size_t blocks) { cipher.encode(in, out, blocks); });
+
+    if constexpr (w <= 64)
+    {
+#if defined(__x86_64__)
+        run("jit", w, r, b, "setup", "cycles/key", 1, [&] { RC5Jit<w> jit(S.data(), r); doNotOptimize(jit.codeSize()); });
+        const RC5Jit<w> jit(S.data(), r);
+        runBlocks<w>("jit", r, b, [&](const uint8_t *in, uint8_t *out, size_t blocks) { jit.encode(in, out, blocks); });
+        breakEven(w, r, b);
+#endif
+
+        runBlocks<w>("simd", r, b, [&](const uint8_t *in, uint8_t *out, size_t blocks) { RC5Simd<w, r, b>::encodeBlocks(S, in, out, blocks); });
+    }
+}
+
+template <uint8_t w, uint8_t... r>
+void benchWord()
+{
+    (benchConfig<w, r, 8>(), ...);
+    (benchConfig<w, r, 16>(), ...);
+}
+
+//////// SMALL-MESSAGE LATENCY
+
+constexpr size_t latencyMessages = 20000;
+constexpr array<size_t, 5> messageSizes = {16, 64, 256, 1024, 4096};
+
+// cycles spent by the timing code itself, subtracted from every call
+static uint64_t timerOverhead;
+
+#if defined(__x86_64__)
+// serializing reads, so the measured call cannot leak out of the interval
+inline uint64_t startTicks()
+{
+    _mm_lfence();
+    return __rdtsc();
+}
+
+inline uint64_t stopTicks()
+{
+    unsigned aux;
+    const uint64_t t = __rdtscp(&aux);
+    _mm_lfence();
+    return t;
+}
+#else
+inline uint64_t startTicks() { return ticks(); }
+inline uint64_t stopTicks() { return ticks(); }
+#endif
+
+void calibrateTimer()
+{
+    timerOverhead = ~uint64_t(0);
+    for (int i = 0; i < 10000; ++i)
+    {
+        const uint64_t start = startTicks();
+        timerOverhead = min(timerOverhead, stopTicks() - start);
+    }
+}
+
+// encrypts latencyMessages messages of one size (0 = sizes drawn log-uniformly
+// from 16 B to 4 KiB) options.repeats times and records the cycles of every
+// call to process(in, out, bytes), along with the percentiles of each repeat
+template <typename Process>
+void runLatency(const string &kernel, int w, int r, int b, size_t size, Process &&process)
+{
+    const string message = size ? to_string(size) : "mix";
+    const string label = kernel + "/" + to_string(w) + "/" + to_string(r) + "/" + to_string(b) + "/latency/" + message;
+    if (!options.filter.empty() && label.find(options.filter) == string::npos)
+        return;
+
+    // the same sequence of sizes for every kernel
+    mt19937 rng(size);
+    uniform_int_distribution<int> exponent(4, 12);
+    vector<uint8_t> data(messageSizes.back(), 0x5A);
+
+    // warm caches, branch predictors and the key
+    for (int i = 0; i < 100; ++i)
+        process(data.data(), data.data(), size ? size : messageSizes.back());
+
+    Histogram histogram{kernel, w, r, b, message, {}, {}};
+    for (int repeat = 0; repeat < options.repeats; ++repeat)
+    {
+        LatencyHistogram pass;
+        for (size_t i = 0; i < latencyMessages; ++i)
+        {
+            const size_t bytes = size ? size : size_t(1) << exponent(rng);
+            const uint64_t start = startTicks();
+            process(data.data(), data.data(), bytes);
+            const uint64_t ticks = stopTicks() - start;
+            const uint64_t cycles = ticks > timerOverhead ? ticks - timerOverhead : 0;
+            pass.record(cycles);
+            histogram.cycles.record(cycles);
+        }
+        array<uint64_t, 5> sample;
+        for (size_t p = 0; p < sample.size(); ++p)
+            sample[p] = pass.percentile(percentilePoints[p]);
+        histogram.samples.push_back(sample);
+    }
+    doNotOptimize(data[0]);
+    histograms.push_back(move(histogram));
+}
+
+// every path a request can take: the one-shot encode (key setup on every
+// block), a warm expanded key, the runtime facade with its dispatch, the
+// facade built per request (cold key), and the specialized backends
+template <uint8_t w, uint8_t r, uint8_t b>
+void benchLatency()
+{
+    using Cipher = RC5<w, r, b>;
+    using Block = array<uint8_t, 2 * Cipher::u>;
+    static constexpr auto key = benchKey<b>();
+    const auto S = Cipher::setupS(key);
+    const RC5Cipher cipher(w, r, key.data(), b);
+#if defined(__x86_64__)
+    const RC5Jit<w> jit(S.data(), r);
+#endif
+
+    for (size_t i = 0; i <= messageSizes.size(); ++i)
+    {
+        const size_t size = i < messageSizes.size() ? messageSizes[i] : 0;
+        runLatency("encode", w, r, b, size, [&](const uint8_t *in, uint8_t *out, size_t bytes) {
+            for (size_t k = 0; k < bytes; k += sizeof(Block))
+            {
+                Block block;
+                memcpy(block.data(), in + k, sizeof(Block));
+                block = Cipher::encode(key, block);
+                memcpy(out + k, block.data(), sizeof(Block));
+            }
+        });
+        runLatency("scalar", w, r, b, size, [&](const uint8_t *in, uint8_t *out, size_t bytes) { Cipher::encodeBlocks(S, in, out, bytes / sizeof(Block)); });
+        runLatency("cipher", w, r, b, size, [&](const uint8_t *in, uint8_t *out, size_t bytes) { cipher.encode(in, out, bytes / sizeof(Block)); });
+        runLatency("cipher-cold", w, r, b, size, [&](const uint8_t *in, uint8_t *out, size_t bytes) { RC5Cipher(w, r, key.data(), b).encode(in, out, bytes / sizeof(Block)); });
+        runLatency("fixed", w, r, b, size, [&](const uint8_t *in, uint8_t *out, size_t bytes) { RC5Fixed<w, r, key>::encodeBlocks(in, out, bytes / sizeof(Block)); });
+#if defined(__x86_64__)
+        runLatency("jit", w, r, b, size, [&](const uint8_t *in, uint8_t *out, size_t bytes) { jit.encode(in, out, bytes / sizeof(Block)); });
+#endif
+        runLatency("simd", w, r, b, size, [&](const uint8_t *in, uint8_t *out, size_t bytes) { RC5Simd<w, r, b>::encodeBlocks(S, in, out, bytes / sizeof(Block)); });
+    }
+}
+
+//////// MULTI-KEY WORKING SET
+
+constexpr size_t keyMessages = 20000;
+constexpr size_t keyMessageBytes = 64;
+constexpr size_t maxWorkingSet = size_t(512) << 20;
+
+// key indices for every message: uniform, or Zipf (s = 1) over a shuffled
+// key order so the hot keys are scattered through the schedule array
+vector<uint32_t> keySequence(size_t keys, bool zipf, mt19937 &rng)
+{
+    vector<uint32_t> sequence(keyMessages);
+    if (!zipf)
+    {
+        uniform_int_distribution<uint32_t> pick(0, keys - 1);
+        for (auto &k : sequence)
+            k = pick(rng);
+        return sequence;
+    }
+
+    vector<double> cdf(keys);
+    double sum = 0;
+    for (size_t i = 0; i < keys; ++i)
+        cdf[i] = sum += 1.0 / (i + 1);
+    vector<uint32_t> order(keys);
+    for (size_t i = 0; i < keys; ++i)
+        order[i] = i;
+    shuffle(order.begin(), order.end(), rng);
+
+    uniform_real_distribution<double> uniform(0, sum);
+    for (auto &k : sequence)
+        k = order[min<size_t>(lower_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin(), keys - 1)];
+    return sequence;
+}
+
+// one contiguous array of expanded keys, as a key cache would hold them;
+// every message picks its key from the sequence, so once the schedules
+// outgrow L1/L2/L3 each message starts with cache misses on S
+template <uint8_t w, uint8_t r, uint8_t b>
+void benchKeys()
+{
+    using Cipher = RC5<w, r, b>;
+    using Schedule = typename Cipher::Schedule;
+    mt19937 rng(w * 256 + r);
+
+    for (size_t keys = 1; keys <= 65536 && keys * sizeof(Schedule) <= maxWorkingSet; keys *= 4)
+    {
+        vector<Schedule> schedules(keys);
+        typename Cipher::Key key{};
+        for (size_t i = 0; i < keys; ++i)
+        {
+            for (auto &byte : key)
+                byte = uint8_t(rng());
+            schedules[i] = Cipher::setupS(key);
+        }
+
+        for (bool zipf : {false, true})
+        {
+            const vector<uint32_t> sequence = keySequence(keys, zipf, rng);
+            vector<uint8_t> data(keyMessageBytes, 0x5A);
+            const string mode = string(zipf ? "zipf-" : "uniform-") + to_string(keys);
+            const bool ran = run("scalar", w, r, b, mode, "cycles/byte", keyMessages * keyMessageBytes, [&] {
+                for (uint32_t k : sequence)
+                    Cipher::encodeBlocks(schedules[k], data.data(), data.data(), keyMessageBytes / (2 * Cipher::u));
+                doNotOptimize(data[0]);
+            });
+            if (ran)
+                results.back().workingSet = keys * sizeof(Schedule);
+        }
+    }
+}
+
+//////// KEY SEARCH
+
+constexpr uint64_t searchKeys = 200000;
+
+// ticks per second, for rates
+double tickRate()
+{
+    const auto start = chrono::steady_clock::now();
+    const uint64_t startTicks = ticks();
+    while (chrono::steady_clock::now() - start < chrono::milliseconds(100))
+        ;
+    return (ticks() - startTicks) / chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// a key range that does not contain the key, so every candidate is rejected:
+// "encode" is the obvious loop over RC5::encode and a full block compare,
+// "search" is RC5KeySearch with its unrolled key setup and early exit,
+// "simd" is RC5KeySearchSimd with one key per lane
+template <uint8_t w, uint8_t r, uint8_t b>
+void benchSearch(double rate)
+{
+    using Search = RC5KeySearch<w, r, b>;
+    using Block = typename Search::Block;
+
+    const typename Search::Key key = benchKey<b>();
+    Block plaintext{};
+    for (size_t i = 0; i < plaintext.size(); ++i)
+        plaintext[i] = uint8_t(i);
+    const Block ciphertext = RC5<w, r, b>::encode(key, plaintext);
+    const typename Search::Key start = Search::advance(key, 1);
+
+    const auto keysPerSecond = [&](bool ran) {
+        if (ran)
+            results.back().keysPerSecond = rate / results.back().value;
+    };
+
+    keysPerSecond(run("encode", w, r, b, "search", "cycles/key", searchKeys, [&] {
+        typename Search::Key candidate = start;
+        bool found = false;
+        for (uint64_t i = 0; i < searchKeys; ++i, Search::advance(candidate))
+            found |= RC5<w, r, b>::encode(candidate, plaintext) == ciphertext;
+        doNotOptimize(found);
+    }));
+
+    const Search search(plaintext, ciphertext);
+    keysPerSecond(run("search", w, r, b, "search", "cycles/key", searchKeys, [&] {
+        doNotOptimize(search.search(start, searchKeys).found);
+    }));
+
+    const RC5KeySearchSimd<w, r, b> simd(plaintext, ciphertext);
+    keysPerSecond(run("simd", w, r, b, "search", "cycles/key", searchKeys, [&] {
+        doNotOptimize(simd.search(start, searchKeys).found);
+    }));
+}
+
+//////// OUTPUT
+
+void printJson()
+{
+    cout << "{\n  \"cpu\": " << options.cpu << ",\n  \"repeats\": " << options.repeats << ",\n  \"results\": [\n";
+    cout << setprecision(6);
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const Result &res = results[i];
+        cout << "    {\"kernel\": \"" << res.kernel << "\", \"w\": " << res.w << ", \"r\": " << res.r << ", \"b\": " << res.b
+             << ", \"mode\": \"" << res.mode << "\", \"unit\": \"" << res.unit << "\", \"value\": " << res.value << ", \"samples\": [";
+        for (size_t j = 0; j < res.samples.size(); ++j)
+            cout << (j ? ", " : "") << res.samples[j];
+        cout << "]";
+        if (res.workingSet)
+            cout << ", \"working_set\": " << res.workingSet;
+        if (res.keysPerSecond)
+            cout << ", \"keys_per_second\": " << res.keysPerSecond;
+        if (counters && res.countersUnits)
+        {
+            // counter values per unit, same unit as value; derived rows have none
+            cout << ", \"counters\": {\"ipc\": " << res.counters.ipc();
+            for (int e = 0; e < PerfEventCount; ++e)
+                if (res.counters.valid[e])
+                    cout << ", \"" << PerfCounters::name(PerfEvent(e)) << "\": " << res.counters.values[e] / res.countersUnits;
+            cout << "}";
+        }
+        cout << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    cout << "  ],\n  \"histograms\": [\n";
+    for (size_t i = 0; i < histograms.size(); ++i)
+    {
+        const Histogram &hist = histograms[i];
+        cout << "    {\"kernel\": \"" << hist.kernel << "\", \"w\": " << hist.w << ", \"r\": " << hist.r << ", \"b\": " << hist.b
+             << ", \"message\": \"" << hist.message << "\", \"unit\": \"cycles/call\", \"calls\": " << hist.cycles.count()
+             << ", \"percentiles\": {";
+        for (size_t p = 0; p < percentileNames.size(); ++p)
+            cout << (p ? ", " : "") << "\"" << percentileNames[p] << "\": " << hist.cycles.percentile(percentilePoints[p]);
+        cout << "}, \"samples\": {";
+        for (size_t p = 0; p < percentileNames.size(); ++p)
+        {
+            cout << (p ? ", " : "") << "\"" << percentileNames[p] << "\": [";
+            for (size_t j = 0; j < hist.samples.size(); ++j)
+                cout << (j ? ", " : "") << hist.samples[j][p];
+            cout << "]";
+        }
+        cout << "}, \"max\": " << hist.cycles.maximum() << "}" << (i + 1 < histograms.size() ? "," : "") << "\n";
+    }
+    cout << "  ]\n}\n";
+}
+
+int usage(const char *name)
+{
+    cerr << "usage: " << name << " [--suite grid|latency|keys|search] [--cpu N] [--repeats N] [--filter TEXT] [--no-perf]\n";
+    return 2;
+}
+
+int main(int argc, char **argv)
+{
+    try
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const string arg = argv[i];
+            if (arg == "--suite" && i + 1 < argc)
+                options.suite = argv[++i];
+            else if (arg == "--cpu" && i + 1 < argc)
+                options.cpu = stoi(argv[++i]);
+            else if (arg == "--repeats" && i + 1 < argc)
+                options.repeats = max(1, stoi(argv[++i]));
+            else if (arg == "--filter" && i + 1 < argc)
+                options.filter = argv[++i];
+            else if (arg == "--no-perf")
+                options.perf = false;
+            else
+                return usage(argv[0]);
+        }
+    }
+    catch (const logic_error &)
+    {
+        // a number that is not one, or out of range (stoi and friends)
+        return usage(argv[0]);
+    }
+    // CPU_SET has no room for more
+    if (options.cpu >= CPU_SETSIZE)
+        return usage(argv[0]);
+
+    // pin to one CPU so the TSC and the caches stay the same for the whole run
+    if (options.cpu < 0)
+        options.cpu = sched_getcpu();
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(options.cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0)
+        cerr << "rc5_bench: cannot pin to cpu " << options.cpu << ": " << strerror(errno) << "\n";
+
+    PerfCounters perf;
+    if (options.perf && perf.available())
+        counters = &perf;
+    else if (options.perf)
+        cerr << "rc5_bench: hardware counters unavailable, reporting cycles only\n";
+
+    if (options.suite == "grid")
+    {
+        benchWord<16, 12, 16, 20, 24>();
+        benchWord<32, 12, 16, 20, 24>();
+        benchWord<64, 12, 16, 20, 24>();
+        benchWord<128, 12, 16, 20, 24>();
+    }
+    else if (options.suite == "latency")
+    {
+        calibrateTimer();
+        benchLatency<32, 12, 16>();
+        benchLatency<32, 20, 16>();
+        benchLatency<64, 24, 16>();
+    }
+    else if (options.suite == "keys")
+    {
+        // 104-byte schedules up to 4 KiB ones
+        benchKeys<32, 12, 16>();
+        benchKeys<64, 24, 16>();
+        benchKeys<64, 255, 16>();
+    }
+    else if (options.suite == "search")
+    {
+        // 64-, 72- (as in RC5-72) and 128-bit keys
+        const double rate = tickRate();
+        benchSearch<32, 12, 8>(rate);
+        benchSearch<32, 12, 9>(rate);
+        benchSearch<32, 12, 16>(rate);
+    }
+    else
+    {
+        cerr << "rc5_bench: unknown suite " << options.suite << "\n";
+        return 2;
+    }
+
+    printJson();
+
+    return 0;
+}
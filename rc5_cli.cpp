@@ -0,0 +1,556 @@
+#include "RC5Container.hpp"
+#include "RC5Parallel.hpp"
+#include "RC5Pipeline.hpp"
+#include "RC5Stream.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/random.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//////// FILE ENCRYPTION TOOL
+
+// rc5 encrypt|decrypt --mode ctr|cbc|chunked (--key HEX | --key-file PATH) [--in PATH|-] [--out PATH|-]
+//     [--iv HEX] [--threads N] [--io uring|threads|mmap] [--chunk BYTES] [--quiet]
+// rc5 read (--key HEX | --key-file PATH) --in PATH [--offset N] [--length N] [--out PATH|-] [--threads N] [--quiet]
+//
+// encrypts or decrypts a whole file with RC5-32/12 and a 16-byte key. The
+// encrypted file is the 8-byte iv followed by the ciphertext; CTR keeps the
+// length, CBC pads as RC5-CBC-Pad. The iv is random unless given. CTR goes
+// through RC5Pipeline by default, io_uring or else pread/pwrite threads, so
+// reads and writes overlap the encryption; --io mmap and CBC memory-map input
+// and output, and CTR and CBC decryption run on all cores in block-aligned
+// chunks (CBC encryption is sequential by construction). Standard input and
+// output (- or left out), pipes and other files that are not regular go
+// through RC5Stream instead, reading, encrypting and writing on three
+// threads. Prints the throughput, and for the pipeline how much I/O and
+// encryption overlapped, to stderr. --mode chunked writes an RC5Container
+// instead (chunks of --chunk bytes, 64 KiB by default, each encrypted from
+// its own stretch of counters under a per-file key, with its own tag), which
+// read decrypts any byte range of by touching only the chunks that cover it. Exits with 0 on success, 1 when the input cannot be
+// decrypted (bad length, padding or tag) or a file cannot be used, 2 on bad
+// arguments
+
+using Cipher = RC5<32, 12, 16>;
+using Parallel = RC5Parallel<32, 12, 16>;
+using Block = Parallel::Block;
+using Container = RC5Container<32, 12, 16>;
+
+constexpr size_t blockSize = sizeof(Block);
+
+struct Options
+{
+    string command, mode;
+    string key, keyFile;
+    string in = "-", out = "-";
+    string iv;
+    string io = "uring";
+    size_t chunk = Container::defaultChunk;
+    uint64_t offset = 0, length = UINT64_MAX;
+    unsigned threads = thread::hardware_concurrency();
+    bool quiet = false;
+};
+
+static Options options;
+
+// exactly size bytes or false
+bool fromHex(const string &hex, uint8_t *bytes, size_t size)
+{
+    if (hex.size() != 2 * size || hex.find_first_not_of("0123456789abcdefABCDEF") != string::npos)
+        return false;
+    for (size_t i = 0; i < size; ++i)
+        bytes[i] = uint8_t(stoul(hex.substr(2 * i, 2), nullptr, 16));
+    return true;
+}
+
+// a file mapped in whole; the mapping of an empty file is empty
+class Mapping
+{
+public:
+    // the input, read-only
+    explicit Mapping(const string &path)
+    {
+        fd_ = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat info;
+        if (fd_ < 0 || fstat(fd_, &info) != 0)
+            throw system_error(errno, generic_category(), "cannot open " + path);
+        map(info.st_size, PROT_READ, MAP_PRIVATE, path);
+    }
+
+    // the output, created or truncated to size bytes
+    Mapping(const string &path, size_t size)
+    {
+        fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd_ < 0 || ftruncate(fd_, size) != 0)
+            throw system_error(errno, generic_category(), "cannot create " + path);
+        map(size, PROT_READ | PROT_WRITE, MAP_SHARED, path);
+    }
+
+    Mapping(const Mapping &) = delete;
+    Mapping &operator=(const Mapping &) = delete;
+
+    ~Mapping()
+    {
+        if (size_)
+            munmap(data_, size_);
+        if (fd_ >= 0)
+            close(fd_);
+    }
+
+    uint8_t *data() const
+    {
+        return data_;
+    }
+
+    size_t size() const
+    {
+        return size_;
+    }
+
+    // drops the mapping and cuts the file to size bytes
+    void truncate(size_t size)
+    {
+        if (size_)
+            munmap(data_, size_);
+        size_ = 0;
+        if (ftruncate(fd_, size) != 0)
+            throw system_error(errno, generic_category(), "cannot truncate output");
+    }
+
+private:
+    void map(size_t size, int protection, int flags, const string &path)
+    {
+        size_ = size;
+        if (!size)
+            return;
+        void *data = mmap(nullptr, size, protection, flags, fd_, 0);
+        if (data == MAP_FAILED)
+            throw system_error(errno, generic_category(), "cannot map " + path);
+        data_ = static_cast<uint8_t *>(data);
+        // both are hints; huge pages only take for some file systems
+        madvise(data_, size_, MADV_SEQUENTIAL);
+        madvise(data_, size_, MADV_HUGEPAGE);
+    }
+
+    int fd_ = -1;
+    uint8_t *data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// a file descriptor, closed on the way out
+class File
+{
+public:
+    // - is standard input or output, by the access mode
+    File(const string &path, int flags)
+    {
+        if (path == "-")
+            fd_ = dup((flags & O_ACCMODE) == O_RDONLY ? STDIN_FILENO : STDOUT_FILENO);
+        else
+            fd_ = open(path.c_str(), flags | O_CLOEXEC, 0644);
+        if (fd_ < 0)
+            throw system_error(errno, generic_category(), "cannot open " + path);
+    }
+
+    File(const File &) = delete;
+    File &operator=(const File &) = delete;
+
+    ~File()
+    {
+        close(fd_);
+    }
+
+    int fd() const
+    {
+        return fd_;
+    }
+
+private:
+    int fd_;
+};
+
+void writeAll(int fd, const uint8_t *data, size_t bytes)
+{
+    for (size_t done = 0; done < bytes;)
+    {
+        const ssize_t n = write(fd, data + done, bytes - done);
+        if (n <= 0 && errno != EINTR)
+            throw system_error(errno, generic_category(), "cannot write output");
+        done += max<ssize_t>(n, 0);
+    }
+}
+
+// the iv of a new file, given or random
+Block newIv()
+{
+    Block iv;
+    if (!options.iv.empty())
+    {
+        if (!fromHex(options.iv, iv.data(), iv.size()))
+            throw invalid_argument("the iv is 8 bytes of hex");
+    }
+    else if (getrandom(iv.data(), iv.size(), 0) != ssize_t(iv.size()))
+        throw system_error(errno, generic_category(), "cannot draw an iv");
+    return iv;
+}
+
+// CTR either way through RC5Pipeline; the number of plaintext bytes written
+size_t ctrPipeline(const Cipher::Schedule &S)
+{
+    const File in(options.in, O_RDONLY);
+    const File out(options.out, O_WRONLY | O_CREAT | O_TRUNC);
+    struct stat info;
+    if (fstat(in.fd(), &info) != 0)
+        throw system_error(errno, generic_category(), "cannot open " + options.in);
+
+    Block iv;
+    uint64_t inOffset = 0, outOffset = 0, bytes = info.st_size;
+    if (options.command == "encrypt")
+    {
+        iv = newIv();
+        if (pwrite(out.fd(), iv.data(), iv.size(), 0) != ssize_t(iv.size()))
+            throw system_error(errno, generic_category(), "cannot write " + options.out);
+        outOffset = blockSize;
+    }
+    else
+    {
+        if (bytes < blockSize || pread(in.fd(), iv.data(), iv.size(), 0) != ssize_t(iv.size()))
+            throw runtime_error("input is not a whole ctr file");
+        inOffset = blockSize;
+        bytes -= blockSize;
+    }
+
+    // chunks are whole blocks, so a chunk's offset gives its first counter
+    RC5Pipeline::Options pipelineOptions;
+    pipelineOptions.workers = options.threads;
+    pipelineOptions.uring = options.io == "uring";
+    RC5Pipeline pipeline(pipelineOptions);
+    const auto stats = pipeline.run(in.fd(), inOffset, out.fd(), outOffset, bytes, [&](uint8_t *data, size_t n, uint64_t offset) {
+        Parallel::ctr(S, iv, offset / blockSize, data, data, n, 1);
+    });
+    if (!options.quiet && bytes)
+        cerr << "rc5: " << (stats.uring ? "io_uring" : "pread/pwrite") << ", I/O busy " << fixed << setprecision(3) << stats.ioSeconds
+             << " s, encryption busy " << stats.computeSeconds << " s, both " << stats.overlapSeconds << " s ("
+             << setprecision(0) << 100 * stats.overlapSeconds / max(min(stats.ioSeconds, stats.computeSeconds), 1e-9)
+             << "% of the shorter)\n";
+    return bytes;
+}
+
+// either mode either way through RC5Stream; the number of plaintext bytes written
+size_t stream(const Cipher::Schedule &S)
+{
+    const File in(options.in, O_RDONLY);
+    const File out(options.out, O_WRONLY | O_CREAT | O_TRUNC);
+    const bool encrypting = options.command == "encrypt", ctr = options.mode == "ctr";
+
+    Block iv, previous;
+    if (encrypting)
+    {
+        iv = newIv();
+        writeAll(out.fd(), iv.data(), iv.size());
+    }
+    else
+    {
+        size_t done = 0;
+        for (ssize_t n = 1; done < iv.size() && n;)
+        {
+            n = read(in.fd(), iv.data() + done, iv.size() - done);
+            if (n < 0 && errno != EINTR)
+                throw system_error(errno, generic_category(), "cannot read input");
+            done += max<ssize_t>(n, 0);
+        }
+        if (done < iv.size())
+            throw runtime_error("input is not a whole " + options.mode + " file");
+    }
+    previous = iv;
+
+    // chunks are whole blocks but the last; CBC carries the chain from one
+    // chunk to the next, and its last chunk grows by the padding
+    uint64_t position = 0;
+    const auto transform = [&](uint8_t *data, size_t bytes, bool last) -> size_t {
+        const size_t blocks = bytes / blockSize;
+        position += bytes;
+        if (ctr)
+        {
+            Parallel::ctr(S, iv, (position - bytes) / blockSize, data, data, bytes, options.threads);
+            return bytes;
+        }
+        if (encrypting)
+        {
+            const size_t padded = last ? RC5Cbc<32, 12, 16>::paddedSize(bytes) : bytes;
+            fill(data + bytes, data + padded, uint8_t(padded - bytes));
+            RC5Cbc<32, 12, 16>::encrypt(S, previous, data, data, padded / blockSize);
+            if (padded)
+                copy(data + padded - blockSize, data + padded, previous.begin());
+            return padded;
+        }
+        if (last && (bytes % blockSize || position < blockSize))
+            throw runtime_error("input is not a whole cbc file");
+        const Block chained = previous;
+        if (blocks)
+            copy(data + (blocks - 1) * blockSize, data + blocks * blockSize, previous.begin());
+        Parallel::cbcDecrypt(S, chained, data, data, blocks, options.threads);
+        if (!last)
+            return bytes;
+        const uint8_t pad = data[bytes - 1];
+        if (pad == 0 || pad > blockSize || any_of(data + bytes - pad, data + bytes, [&](uint8_t byte) { return byte != pad; }))
+            throw runtime_error("bad padding, wrong key or not a cbc file");
+        return bytes - pad;
+    };
+
+    RC5Stream::Options streamOptions;
+    streamOptions.tail = blockSize;
+    RC5Stream::Stats stats;
+    try
+    {
+        stats = RC5Stream(streamOptions).run(in.fd(), out.fd(), transform);
+    }
+    catch (...)
+    {
+        // what went out before the failure is no use
+        if (options.out != "-")
+            unlink(options.out.c_str());
+        throw;
+    }
+    if (!options.quiet)
+        cerr << "rc5: streamed, output through " << (stats.spliced ? "vmsplice" : "write") << "\n";
+    return encrypting ? stats.in : stats.out;
+}
+
+// the number of plaintext bytes written
+size_t encrypt(const Cipher::Schedule &S, const Mapping &in, const string &outPath)
+{
+    const Block iv = newIv();
+    const size_t bytes = in.size();
+    const size_t body = options.mode == "ctr" ? bytes : RC5Cbc<32, 12, 16>::paddedSize(bytes);
+    Mapping out(outPath, blockSize + body);
+    copy(iv.begin(), iv.end(), out.data());
+    uint8_t *ciphertext = out.data() + blockSize;
+
+    if (options.mode == "ctr")
+    {
+        Parallel::ctr(S, iv, 0, in.data(), ciphertext, bytes, options.threads);
+        return bytes;
+    }
+
+    // whole blocks straight from the input, then the padded last one chained to them
+    const size_t blocks = bytes / blockSize;
+    RC5Cbc<32, 12, 16>::encrypt(S, iv, in.data(), ciphertext, blocks);
+    Block last, previous = iv;
+    const size_t tail = bytes - blocks * blockSize;
+    fill(last.begin(), last.end(), uint8_t(blockSize - tail));
+    copy(in.data() + blocks * blockSize, in.data() + bytes, last.begin());
+    if (blocks)
+        copy(ciphertext + (blocks - 1) * blockSize, ciphertext + blocks * blockSize, previous.begin());
+    RC5Cbc<32, 12, 16>::encrypt(S, previous, last.data(), ciphertext + blocks * blockSize, 1);
+    return bytes;
+}
+
+// the number of plaintext bytes written
+size_t decrypt(const Cipher::Schedule &S, const Mapping &in, const string &outPath)
+{
+    if (in.size() < blockSize || (options.mode == "cbc" && (in.size() < 2 * blockSize || in.size() % blockSize)))
+        throw runtime_error("input is not a whole " + options.mode + " file");
+    Block iv;
+    copy(in.data(), in.data() + blockSize, iv.begin());
+    const uint8_t *ciphertext = in.data() + blockSize;
+    const size_t body = in.size() - blockSize;
+
+    Mapping out(outPath, body);
+    if (options.mode == "ctr")
+    {
+        Parallel::ctr(S, iv, 0, ciphertext, out.data(), body, options.threads);
+        return body;
+    }
+
+    Parallel::cbcDecrypt(S, iv, ciphertext, out.data(), body / blockSize, options.threads);
+    const uint8_t pad = out.data()[body - 1];
+    if (pad == 0 || pad > blockSize || any_of(out.data() + body - pad, out.data() + body, [&](uint8_t byte) { return byte != pad; }))
+    {
+        out.truncate(0);
+        unlink(outPath.c_str());
+        throw runtime_error("bad padding, wrong key or not a cbc file");
+    }
+    out.truncate(body - pad);
+    return body - pad;
+}
+
+// a container from the whole input; the number of plaintext bytes
+size_t seal(const Container::Keys &keys)
+{
+    const Mapping in(options.in);
+    Mapping out(options.out, Container::sealedSize(in.size(), options.chunk));
+    Container::seal(keys, in.data(), in.size(), out.data(), options.chunk, options.threads);
+    return in.size();
+}
+
+// the plaintext from offset on, length bytes or up to the end, a piece at a
+// time; the number of bytes written
+size_t unseal(const Container::Keys &keys)
+{
+    const File in(options.in, O_RDONLY);
+    const Container::Reader reader(keys, in.fd());
+    const File out(options.out, O_WRONLY | O_CREAT | O_TRUNC);
+    // sixteen chunks per thread and piece, but no more than 64 MiB of them
+    const size_t chunk = reader.chunkBytes();
+    vector<uint8_t> piece(max(chunk, min<size_t>(16 * options.threads, (64 << 20) / chunk) * chunk));
+    uint64_t done = 0;
+    try
+    {
+        for (size_t n = 1; n && done < options.length; done += n)
+        {
+            n = reader.pread(piece.data(), min<uint64_t>(piece.size(), options.length - done), options.offset + done, options.threads);
+            writeAll(out.fd(), piece.data(), n);
+        }
+    }
+    catch (...)
+    {
+        // what went out before the failure is no use
+        if (options.out != "-")
+            unlink(options.out.c_str());
+        throw;
+    }
+    return done;
+}
+
+int usage(const char *name)
+{
+    cerr << "usage: " << name << " encrypt|decrypt --mode ctr|cbc|chunked (--key HEX | --key-file PATH) [--in PATH|-] [--out PATH|-]"
+         << " [--iv HEX] [--threads N] [--io uring|threads|mmap] [--chunk BYTES] [--quiet]\n"
+         << "       " << name << " read (--key HEX | --key-file PATH) --in PATH [--offset N] [--length N] [--out PATH|-]"
+         << " [--threads N] [--quiet]\n";
+    return 2;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+        return usage(argv[0]);
+    options.command = argv[1];
+    try
+    {
+        for (int i = 2; i < argc; ++i)
+        {
+            const string arg = argv[i];
+            const bool value = i + 1 < argc;
+            if (arg == "--mode" && value)
+                options.mode = argv[++i];
+            else if (arg == "--key" && value)
+                options.key = argv[++i];
+            else if (arg == "--key-file" && value)
+                options.keyFile = argv[++i];
+            else if (arg == "--in" && value)
+                options.in = argv[++i];
+            else if (arg == "--out" && value)
+                options.out = argv[++i];
+            else if (arg == "--iv" && value)
+                options.iv = argv[++i];
+            else if (arg == "--threads" && value)
+                options.threads = max(1, stoi(argv[++i]));
+            else if (arg == "--io" && value)
+                options.io = argv[++i];
+            else if (arg == "--chunk" && value)
+                options.chunk = stoull(argv[++i]);
+            else if (arg == "--offset" && value)
+                options.offset = stoull(argv[++i]);
+            else if (arg == "--length" && value)
+                options.length = stoull(argv[++i]);
+            else if (arg == "--quiet")
+                options.quiet = true;
+            else
+                return usage(argv[0]);
+        }
+    }
+    catch (const logic_error &)
+    {
+        // a number that is not one, or out of range (stoi and friends)
+        return usage(argv[0]);
+    }
+    // a read is of a container, and so are offsets
+    if (options.command == "read" && options.mode.empty())
+        options.mode = "chunked";
+    const bool chunked = options.mode == "chunked";
+    if ((options.command != "encrypt" && options.command != "decrypt" && (options.command != "read" || !chunked)) ||
+        (options.mode != "ctr" && options.mode != "cbc" && !chunked) || (!chunked && (options.offset || options.length != UINT64_MAX)) ||
+        (options.io != "uring" && options.io != "threads" && options.io != "mmap") || options.key.empty() == options.keyFile.empty())
+        return usage(argv[0]);
+
+    // the key file holds the 16 raw key bytes
+    Cipher::Key key;
+    if (!options.keyFile.empty())
+    {
+        ifstream file(options.keyFile, ios::binary);
+        if (!file.read(reinterpret_cast<char *>(key.data()), key.size()) || file.peek() != EOF)
+        {
+            cerr << "rc5: the key file must hold exactly 16 bytes\n";
+            return 2;
+        }
+    }
+    else if (!fromHex(options.key, key.data(), key.size()))
+    {
+        cerr << "rc5: the key is 16 bytes of hex\n";
+        return 2;
+    }
+
+    if (chunked && (options.in == "-" || (options.command == "encrypt" && options.out == "-")))
+    {
+        cerr << "rc5: containers are read from and written to regular files\n";
+        return 2;
+    }
+    if (chunked && (!options.chunk || options.chunk % blockSize || options.chunk > Container::maxChunk))
+    {
+        cerr << "rc5: chunks are a positive multiple of 8 bytes up to 16 MiB\n";
+        return 2;
+    }
+
+    // O_TRUNC on the output would wipe the input first
+    struct stat inInfo, outInfo;
+    if (stat(options.in.c_str(), &inInfo) == 0 && stat(options.out.c_str(), &outInfo) == 0 && inInfo.st_dev == outInfo.st_dev &&
+        inInfo.st_ino == outInfo.st_ino)
+    {
+        cerr << "rc5: the output must not be the input\n";
+        return 2;
+    }
+
+    try
+    {
+        const Cipher::Schedule S = Cipher::setupS(key);
+        const auto begin = chrono::steady_clock::now();
+        // anything but regular files can only be read and written in order
+        struct stat info;
+        const bool streaming = options.in == "-" || options.out == "-" || stat(options.in.c_str(), &info) != 0 ||
+                               !S_ISREG(info.st_mode) || (stat(options.out.c_str(), &info) == 0 && !S_ISREG(info.st_mode));
+        size_t bytes;
+        if (chunked)
+            bytes = options.command == "encrypt" ? seal(Container::Keys(key)) : unseal(Container::Keys(key));
+        else if (streaming)
+            bytes = stream(S);
+        else if (options.mode == "ctr" && options.io != "mmap")
+            bytes = ctrPipeline(S);
+        else
+        {
+            const Mapping in(options.in);
+            bytes = options.command == "encrypt" ? encrypt(S, in, options.out) : decrypt(S, in, options.out);
+        }
+        const double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+        if (!options.quiet)
+            cerr << "rc5: " << (options.command == "read" ? "read" : options.command + "ed") << " " << bytes << " bytes in " << fixed << setprecision(3) << seconds << " s, "
+                 << setprecision(2) << bytes / max(seconds, 1e-9) / 1e9 << " GB/s, " << options.threads << " threads\n";
+        return 0;
+    }
+    catch (const invalid_argument &e)
+    {
+        cerr << "rc5: " << e.what() << "\n";
+        return 2;
+    }
+    catch (const exception &e)
+    {
+        cerr << "rc5: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,221 @@
+#include "RC5SearchCluster.hpp"
+
+#include <csignal>
+#include <iomanip>
+
+#include <sys/wait.h>
+
+//////// MULTI-PROCESS KEY SEARCH TOOL
+
+// rc5_cluster serve --socket PATH --plaintext HEX --ciphertext HEX --start HEX --count N
+//                   [--unit N] [--lease SECONDS] [--workers N] [--interval SECONDS]
+// rc5_cluster work --socket PATH
+//
+// serve hands the units of an RC5-32/12 key search out to the worker processes
+// that connect to the Unix-domain socket at PATH, and --workers starts that
+// many of them on this machine. The key length is the length of start (1 to
+// 16 bytes). serve prints the key and exits with 0 when it is found, 1 when
+// the range is exhausted, 3 when interrupted, 2 on bad input; work exits with
+// 0 when the search is finished and 1 when the coordinator goes away
+
+struct Options
+{
+    string socket;
+    string plaintext, ciphertext, start;
+    uint64_t count = 0;
+    uint64_t unit = uint64_t(1) << 20;
+    int lease = 30;
+    unsigned workers = 0;
+    int interval = 10;
+};
+
+static Options options;
+static atomic<bool> interrupted{false};
+
+template <uint8_t b>
+int work(RC5SearchConnection &&connection, const string &job)
+{
+    try
+    {
+        const auto result = RC5SearchWorker<32, 12, b>(move(connection), job).run();
+        cerr << "rc5_cluster: worker " << getpid() << " searched " << result.units << " units\n";
+        return result.finished ? 0 : 1;
+    }
+    catch (const exception &e)
+    {
+        cerr << "rc5_cluster: " << e.what() << "\n";
+        return 2;
+    }
+}
+
+// the job says which key length to build the worker for
+template <uint8_t... b>
+int work(integer_sequence<uint8_t, b...>)
+{
+    try
+    {
+        auto connection = RC5SearchConnection::connect(options.socket);
+        string job;
+        if (!connection.receive(job))
+            throw runtime_error("coordinator closed the connection");
+        const string keyBytes = RC5SearchConnection::fields(job)["b"];
+        int status = 2;
+        if (!((keyBytes == to_string(b + 1) ? (status = work<b + 1>(move(connection), job), true) : false) || ...))
+            cerr << "rc5_cluster: unsupported job: " << job << "\n";
+        return status;
+    }
+    catch (const exception &e)
+    {
+        cerr << "rc5_cluster: " << e.what() << "\n";
+        return 1;
+    }
+}
+
+template <uint8_t b>
+int serve()
+{
+    using Coordinator = RC5SearchCoordinator<32, 12, b>;
+    using Runner = RC5SearchRunner<32, 12, b>;
+    typename Coordinator::Job job;
+    if (!Runner::fromHex(options.start, job.start.data(), b) ||
+        !Runner::fromHex(options.plaintext, job.plaintext.data(), job.plaintext.size()) ||
+        !Runner::fromHex(options.ciphertext, job.ciphertext.data(), job.ciphertext.size()))
+    {
+        cerr << "rc5_cluster: blocks are 8 bytes of hex, keys 1 to 16 bytes\n";
+        return 2;
+    }
+    job.count = options.count;
+    job.unitKeys = options.unit;
+
+    try
+    {
+        Coordinator coordinator(job, options.socket, chrono::seconds(options.lease));
+
+        // local workers, forked before any thread exists
+        vector<pid_t> children;
+        for (unsigned i = 0; i < options.workers; ++i)
+        {
+            const pid_t child = fork();
+            if (child == 0)
+            {
+                signal(SIGINT, SIG_DFL);
+                signal(SIGTERM, SIG_DFL);
+                _exit(work(make_integer_sequence<uint8_t, 16>{}));
+            }
+            if (child > 0)
+                children.push_back(child);
+        }
+
+        // the signal only sets a flag, a watcher thread passes it on
+        atomic<bool> finished{false};
+        thread watcher([&] {
+            while (!finished)
+            {
+                if (interrupted)
+                    coordinator.stop();
+                this_thread::sleep_for(chrono::milliseconds(50));
+            }
+        });
+
+        const auto result = coordinator.run(
+            [](const typename Coordinator::Progress &progress) {
+                cerr << "rc5_cluster: " << progress.unitsDone << "/" << progress.units << " units (" << fixed << setprecision(1)
+                     << 100.0 * progress.unitsDone / progress.units << "%), " << progress.workers << " workers, " << progress.leased
+                     << " units leased, " << progress.reissued << " reissued\n";
+            },
+            chrono::seconds(options.interval));
+        finished = true;
+        watcher.join();
+        for (const pid_t child : children)
+        {
+            if (!result.found && !result.complete)
+                kill(child, SIGTERM);
+            waitpid(child, nullptr, 0);
+        }
+
+        if (result.found)
+        {
+            cout << Runner::toHex(result.key.data(), b) << "\n";
+            return 0;
+        }
+        return result.complete ? 1 : 3;
+    }
+    catch (const exception &e)
+    {
+        cerr << "rc5_cluster: " << e.what() << "\n";
+        return 2;
+    }
+}
+
+template <uint8_t... b>
+int serve(size_t keyBytes, integer_sequence<uint8_t, b...>)
+{
+    int status = 2;
+    ((keyBytes == b + 1 ? (status = serve<b + 1>(), true) : false) || ...);
+    return status;
+}
+
+int usage(const char *name)
+{
+    cerr << "usage: " << name << " serve --socket PATH --plaintext HEX --ciphertext HEX --start HEX --count N"
+         << " [--unit N] [--lease SECONDS] [--workers N] [--interval SECONDS]\n"
+         << "       " << name << " work --socket PATH\n";
+    return 2;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+        return usage(argv[0]);
+    const string mode = argv[1];
+    try
+    {
+        for (int i = 2; i < argc; ++i)
+        {
+            const string arg = argv[i];
+            const bool value = i + 1 < argc;
+            if (arg == "--socket" && value)
+                options.socket = argv[++i];
+            else if (arg == "--plaintext" && value)
+                options.plaintext = argv[++i];
+            else if (arg == "--ciphertext" && value)
+                options.ciphertext = argv[++i];
+            else if (arg == "--start" && value)
+                options.start = argv[++i];
+            else if (arg == "--count" && value)
+                options.count = stoull(argv[++i]);
+            else if (arg == "--unit" && value)
+                options.unit = max<uint64_t>(1, stoull(argv[++i]));
+            else if (arg == "--lease" && value)
+                options.lease = max(1, stoi(argv[++i]));
+            else if (arg == "--workers" && value)
+                options.workers = max(0, stoi(argv[++i]));
+            else if (arg == "--interval" && value)
+                options.interval = max(1, stoi(argv[++i]));
+            else
+                return usage(argv[0]);
+        }
+    }
+    catch (const logic_error &)
+    {
+        // a number that is not one, or out of range (stoi and friends)
+        return usage(argv[0]);
+    }
+    if (options.socket.empty())
+        return usage(argv[0]);
+
+    if (mode == "work")
+        return work(make_integer_sequence<uint8_t, 16>{});
+    if (mode != "serve" || options.plaintext.empty() || options.ciphertext.empty() || options.start.empty() || !options.count)
+        return usage(argv[0]);
+    if (options.start.size() % 2 || options.start.size() < 2 || options.start.size() > 32)
+    {
+        cerr << "rc5_cluster: the start key must be 1 to 16 bytes of hex\n";
+        return 2;
+    }
+
+    signal(SIGINT, [](int) { interrupted = true; });
+    signal(SIGTERM, [](int) { interrupted = true; });
+
+    return serve(options.start.size() / 2, make_integer_sequence<uint8_t, 16>{});
+}
@@ -0,0 +1,389 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//////// BENCHMARK REGRESSION GATE
+
+// rc5_compare BASELINE.json CANDIDATE.json [--threshold PCT] [--alpha P]
+//
+// matches the rows of two rc5_bench outputs on (kernel, w, r, b, mode) and
+// runs a one-sided Mann-Whitney U test on their samples. Latency histograms
+// become rows kernel/w/r/b/latency/MESSAGE/PERCENTILE for p50, p99 and p99.9,
+// sampled once per repeat. A row regresses when
+// its median got worse by more than the threshold and the test rejects "not
+// slower" at level alpha. Exits with 1 if any row regressed, 2 on bad input.
+
+//////// MINIMAL JSON READER
+
+// just enough JSON for rc5_bench output: objects, arrays, strings without
+// escapes beyond \", numbers, true/false/null
+struct Json
+{
+    enum Type { Null, Bool, Number, String, Array, Object } type = Null;
+    double number = 0;
+    string text;
+    vector<Json> items;
+    map<string, Json> fields;
+
+    const Json &operator[](const string &key) const
+    {
+        const auto it = fields.find(key);
+        if (it == fields.end())
+            throw runtime_error("missing field \"" + key + "\"");
+        return it->second;
+    }
+};
+
+class JsonParser
+{
+public:
+    explicit JsonParser(const string &input) : s_(input) {}
+
+    Json parse()
+    {
+        Json value = parseValue();
+        skip();
+        if (pos_ != s_.size())
+            fail("trailing characters");
+        return value;
+    }
+
+private:
+    void skip()
+    {
+        while (pos_ < s_.size() && isspace(uint8_t(s_[pos_])))
+            ++pos_;
+    }
+
+    [[noreturn]] void fail(const string &what) const
+    {
+        throw runtime_error("JSON: " + what + " at offset " + to_string(pos_));
+    }
+
+    void expect(char c)
+    {
+        skip();
+        if (pos_ >= s_.size() || s_[pos_] != c)
+            fail(string("expected '") + c + "'");
+        ++pos_;
+    }
+
+    bool consume(char c)
+    {
+        skip();
+        if (pos_ < s_.size() && s_[pos_] == c)
+        {
+            ++pos_;
+            return true;
+        }
+        return false;
+    }
+
+    string parseString()
+    {
+        expect('"');
+        string out;
+        while (pos_ < s_.size() && s_[pos_] != '"')
+        {
+            if (s_[pos_] == '\\' && pos_ + 1 < s_.size())
+                ++pos_;
+            out += s_[pos_++];
+        }
+        expect('"');
+        return out;
+    }
+
+    Json parseValue()
+    {
+        skip();
+        if (pos_ >= s_.size())
+            fail("unexpected end");
+
+        Json value;
+        const char c = s_[pos_];
+        if (c == '{')
+        {
+            value.type = Json::Object;
+            ++pos_;
+            if (consume('}'))
+                return value;
+            do
+            {
+                const string key = parseString();
+                expect(':');
+                value.fields[key] = parseValue();
+            } while (consume(','));
+            expect('}');
+        }
+        else if (c == '[')
+        {
+            value.type = Json::Array;
+            ++pos_;
+            if (consume(']'))
+                return value;
+            do
+                value.items.push_back(parseValue());
+            while (consume(','));
+            expect(']');
+        }
+        else if (c == '"')
+        {
+            value.type = Json::String;
+            value.text = parseString();
+        }
+        else if (s_.compare(pos_, 4, "true") == 0 || s_.compare(pos_, 5, "false") == 0)
+        {
+            value.type = Json::Bool;
+            value.number = s_[pos_] == 't';
+            pos_ += s_[pos_] == 't' ? 4 : 5;
+        }
+        else if (s_.compare(pos_, 4, "null") == 0)
+            pos_ += 4;
+        else
+        {
+            size_t used = 0;
+            try
+            {
+                value.number = stod(s_.substr(pos_, 32), &used);
+            }
+            catch (const logic_error &)
+            {
+                fail("bad value");
+            }
+            value.type = Json::Number;
+            pos_ += used;
+        }
+        return value;
+    }
+
+    const string &s_;
+    size_t pos_ = 0;
+};
+
+//////// STATISTICS
+
+struct Row
+{
+    string label;
+    double value;
+    vector<double> samples;
+};
+
+inline double normalTail(double z)
+{
+    return 0.5 * erfc(z / sqrt(2.0));
+}
+
+// one-sided p-value for "candidate samples tend to be larger than baseline"
+// (larger is slower for every rc5_bench unit). Exact null distribution for
+// small samples without ties, normal approximation with tie and continuity
+// correction otherwise
+double mannWhitney(const vector<double> &baseline, const vector<double> &candidate)
+{
+    const size_t n1 = candidate.size(), n2 = baseline.size();
+    if (!n1 || !n2)
+        return 1;
+
+    // ranks over the pooled samples, ties get their average rank
+    vector<pair<double, int>> pooled;
+    for (double x : candidate)
+        pooled.push_back({x, 0});
+    for (double x : baseline)
+        pooled.push_back({x, 1});
+    sort(pooled.begin(), pooled.end());
+
+    double rankSum = 0, tieTerm = 0;
+    bool ties = false;
+    for (size_t i = 0; i < pooled.size();)
+    {
+        size_t j = i;
+        while (j < pooled.size() && pooled[j].first == pooled[i].first)
+            ++j;
+        const double rank = (i + 1 + j) / 2.0;
+        for (size_t k = i; k < j; ++k)
+            if (pooled[k].second == 0)
+                rankSum += rank;
+        const double t = j - i;
+        tieTerm += t * t * t - t;
+        ties |= t > 1;
+        i = j;
+    }
+    const double U = rankSum - n1 * (n1 + 1) / 2.0;
+
+    if (!ties && n1 + n2 <= 40)
+    {
+        // count[n][m][u]: arrangements of n candidate and m baseline samples with statistic u
+        const size_t maxU = n1 * n2;
+        vector<vector<vector<double>>> count(n1 + 1, vector<vector<double>>(n2 + 1, vector<double>(maxU + 1, 0)));
+        for (size_t n = 0; n <= n1; ++n)
+            for (size_t m = 0; m <= n2; ++m)
+                for (size_t u = 0; u <= maxU; ++u)
+                {
+                    if (n == 0 || m == 0)
+                    {
+                        count[n][m][u] = u == 0;
+                        continue;
+                    }
+                    // the largest sample is either a candidate (beats all m) or a baseline one
+                    count[n][m][u] = (u >= m ? count[n - 1][m][u - m] : 0) + count[n][m - 1][u];
+                }
+        double tail = 0, total = 0;
+        for (size_t u = 0; u <= maxU; ++u)
+        {
+            total += count[n1][n2][u];
+            if (u >= U)
+                tail += count[n1][n2][u];
+        }
+        return tail / total;
+    }
+
+    const double N = n1 + n2;
+    const double mean = n1 * n2 / 2.0;
+    const double variance = n1 * n2 / 12.0 * ((N + 1) - tieTerm / (N * (N - 1)));
+    if (variance <= 0)
+        return 1;
+    return normalTail((U - mean - 0.5) / sqrt(variance));
+}
+
+//////// COMPARISON
+
+map<string, Row> load(const string &path)
+{
+    ifstream file(path);
+    if (!file)
+        throw runtime_error("cannot open " + path);
+    stringstream buffer;
+    buffer << file.rdbuf();
+    const string text = buffer.str();
+    const Json root = JsonParser(text).parse();
+
+    map<string, Row> rows;
+    for (const Json &res : root["results"].items)
+    {
+        Row row;
+        row.label = res["kernel"].text + "/" + to_string(int(res["w"].number)) + "/" + to_string(int(res["r"].number)) + "/" +
+                    to_string(int(res["b"].number)) + "/" + res["mode"].text;
+        row.value = res["value"].number;
+        for (const Json &sample : res["samples"].items)
+            row.samples.push_back(sample.number);
+        rows[row.label] = row;
+    }
+
+    // the latency suite: the tail percentiles worth gating, each against the
+    // same percentile of every repeat
+    if (root.fields.count("histograms"))
+        for (const Json &hist : root["histograms"].items)
+            for (const char *percentile : {"p50", "p99", "p99.9"})
+            {
+                Row row;
+                row.label = hist["kernel"].text + "/" + to_string(int(hist["w"].number)) + "/" + to_string(int(hist["r"].number)) +
+                            "/" + to_string(int(hist["b"].number)) + "/latency/" + hist["message"].text + "/" + percentile;
+                row.value = hist["percentiles"][percentile].number;
+                for (const Json &sample : hist["samples"][percentile].items)
+                    row.samples.push_back(sample.number);
+                rows[row.label] = row;
+            }
+    if (rows.empty())
+        throw runtime_error("no results or histograms in " + path);
+    return rows;
+}
+
+int usage(const char *name)
+{
+    cerr << "usage: " << name << " BASELINE.json CANDIDATE.json [--threshold PCT] [--alpha P]\n";
+    return 2;
+}
+
+int main(int argc, char **argv)
+{
+    vector<string> files;
+    double threshold = 5, alpha = 0.01;
+    try
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const string arg = argv[i];
+            if (arg == "--threshold" && i + 1 < argc)
+                threshold = stod(argv[++i]);
+            else if (arg == "--alpha" && i + 1 < argc)
+                alpha = stod(argv[++i]);
+            else
+                files.push_back(arg);
+        }
+    }
+    catch (const logic_error &)
+    {
+        // a number that is not one, or out of range (stod)
+        return usage(argv[0]);
+    }
+    // written so that NaN fails too
+    if (files.size() != 2 || !(threshold >= 0) || !(alpha > 0 && alpha <= 1))
+        return usage(argv[0]);
+
+    map<string, Row> baseline, candidate;
+    try
+    {
+        baseline = load(files[0]);
+        candidate = load(files[1]);
+    }
+    catch (const exception &e)
+    {
+        cerr << "rc5_compare: " << e.what() << "\n";
+        return 2;
+    }
+
+    // wide enough for the longest label, latency percentiles included
+    size_t width = 28;
+    for (const map<string, Row> *rows : {&baseline, &candidate})
+        for (const auto &[label, row] : *rows)
+            width = max(width, label.size() + 2);
+
+    size_t regressions = 0, improvements = 0, missing = 0;
+    cout << left << setw(width) << "row" << right << setw(12) << "baseline" << setw(12) << "candidate" << setw(9) << "change"
+         << setw(10) << "p" << "  status\n";
+    for (const auto &[label, base] : baseline)
+    {
+        const auto it = candidate.find(label);
+        if (it == candidate.end())
+        {
+            ++missing;
+            cout << left << setw(width) << label << right << "  missing in candidate\n";
+            continue;
+        }
+        const Row &cand = it->second;
+        const double change = base.value ? 100 * (cand.value - base.value) / base.value : 0;
+        const double pWorse = mannWhitney(base.samples, cand.samples);
+        const double pBetter = mannWhitney(cand.samples, base.samples);
+
+        string status = "ok";
+        if (change > threshold && pWorse < alpha)
+        {
+            status = "REGRESSION";
+            ++regressions;
+        }
+        else if (-change > threshold && pBetter < alpha)
+        {
+            status = "improved";
+            ++improvements;
+        }
+        cout << left << setw(width) << label << right << fixed << setprecision(3) << setw(12) << base.value << setw(12) << cand.value
+             << setprecision(1) << setw(8) << change << "%" << setprecision(4) << setw(10) << min(pWorse, pBetter) << "  " << status << "\n";
+    }
+    for (const auto &[label, cand] : candidate)
+        if (!baseline.count(label))
+            cout << left << setw(width) << label << right << "  new in candidate\n";
+
+    cout << regressions << " regression(s), " << improvements << " improvement(s), " << missing << " missing, threshold "
+         << setprecision(1) << threshold << "%, alpha " << setprecision(4) << alpha << "\n";
+    return regressions ? 1 : 0;
+}
@@ -0,0 +1,238 @@
+//////// COMPILE-TIME BENCHMARK
+
+// rc5_compile_bench [--cxx PATH] [--repeats N] [--max-bytes N] [--filter TEXT] > compile.json
+//
+// measures how long the compiler takes to encrypt an embedded blob during
+// constant evaluation, for blob sizes from 1 KiB up to --max-bytes (default
+// 1 MiB). The driver writes a random blob as an initializer list and compiles
+// this same file against it with -fsyntax-only, once per kernel:
+//   none    the blob alone, parsing and constant initialization as baseline
+//   encode  RC5::encode per block, which expands the key for every block
+//   array   RC5::encodeArray, one key expansion, one constant expression
+//   fixed   RC5Fixed::encodeArray, same with the unrolled rounds
+//   blob    RC5Fixed::encodedBlob, evaluated in chunks
+// A kernel is dropped at the first size that does not compile, which is
+// where it runs into -fconstexpr-ops-limit. The JSON has the rc5_bench
+// layout (mode "compile-BYTES", unit "ms"), so rc5_compare can gate it
+
+#if defined(RC5_COMPILE_KERNEL)
+
+#include "RC5.hpp"
+
+namespace
+{
+using Cipher = RC5<32, 12, 16>;
+
+constexpr Cipher::Key key = {0x0B, 0x30, 0x55, 0x7A, 0x9F, 0xC4, 0xE9, 0x0E, 0x33, 0x58, 0x7D, 0xA2, 0xC7, 0xEC, 0x11, 0x36};
+
+constexpr array<uint8_t, RC5_COMPILE_BYTES> plaintext = {
+#include RC5_COMPILE_DATA
+};
+
+#if RC5_COMPILE_KERNEL == 0
+constexpr const auto &ciphertext = plaintext;
+#elif RC5_COMPILE_KERNEL == 1
+constexpr auto ciphertext = [] {
+    array<uint8_t, plaintext.size()> out{};
+    for (size_t k = 0; k < plaintext.size(); k += 8)
+    {
+        array<uint8_t, 8> block{};
+        copy(plaintext.begin() + k, plaintext.begin() + k + 8, block.begin());
+        block = Cipher::encode(key, block);
+        copy(block.begin(), block.end(), out.begin() + k);
+    }
+    return out;
+}();
+#elif RC5_COMPILE_KERNEL == 2
+constexpr auto ciphertext = Cipher::encodeArray(key, plaintext);
+#elif RC5_COMPILE_KERNEL == 3
+constexpr auto ciphertext = RC5Fixed<32, 12, key>::encodeArray(plaintext);
+#elif RC5_COMPILE_KERNEL == 4
+constexpr const auto &ciphertext = RC5Fixed<32, 12, key>::encodedBlob<plaintext>;
+#endif
+
+static_assert(ciphertext.size() == plaintext.size());
+} // namespace
+
+#else
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+struct Options
+{
+    string cxx = getenv("CXX") ? getenv("CXX") : "g++";
+    int repeats = 3;
+    size_t maxBytes = 1 << 20;
+    string filter;
+};
+
+struct Result
+{
+    string kernel;
+    size_t bytes;
+    double value; // median of samples
+    vector<double> samples;
+};
+
+Options options;
+
+inline double median(vector<double> values)
+{
+    sort(values.begin(), values.end());
+    const size_t n = values.size();
+    return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+// runs the compiler on this file for one kernel and blob, output discarded;
+// returns the wall time in milliseconds, or a negative value if it failed
+double compile(int kernel, size_t bytes, const string &data)
+{
+    const vector<string> args = {options.cxx,
+                                 "-std=c++20",
+                                 "-fsyntax-only",
+                                 "-DRC5_COMPILE_KERNEL=" + to_string(kernel),
+                                 "-DRC5_COMPILE_BYTES=" + to_string(bytes),
+                                 "-DRC5_COMPILE_DATA=\"" + data + "\"",
+                                 __FILE__};
+    vector<char *> argv;
+    for (const string &arg : args)
+        argv.push_back(const_cast<char *>(arg.c_str()));
+    argv.push_back(nullptr);
+
+    const auto start = chrono::steady_clock::now();
+    const pid_t pid = fork();
+    if (pid < 0)
+        return -1;
+    if (pid == 0)
+    {
+        const int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    const double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? ms : -1;
+}
+
+// the blob as the body of an initializer list
+bool writeBlob(const string &path, size_t bytes, mt19937 &rng)
+{
+    ofstream out(path, ios::trunc);
+    for (size_t i = 0; i < bytes; ++i)
+        out << unsigned(uint8_t(rng())) << (i % 32 == 31 ? ",\n" : ",");
+    return bool(out.flush());
+}
+
+int usage(const char *name)
+{
+    cerr << "usage: " << name << " [--cxx PATH] [--repeats N] [--max-bytes N] [--filter TEXT]\n";
+    return 2;
+}
+
+int main(int argc, char **argv)
+{
+    try
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const string arg = argv[i];
+            if (arg == "--cxx" && i + 1 < argc)
+                options.cxx = argv[++i];
+            else if (arg == "--repeats" && i + 1 < argc)
+                options.repeats = max(1, stoi(argv[++i]));
+            else if (arg == "--max-bytes" && i + 1 < argc)
+                options.maxBytes = stoull(argv[++i]);
+            else if (arg == "--filter" && i + 1 < argc)
+                options.filter = argv[++i];
+            else
+                return usage(argv[0]);
+        }
+    }
+    catch (const logic_error &)
+    {
+        // a number that is not one, or out of range (stoi and friends)
+        return usage(argv[0]);
+    }
+
+    const char *kernels[] = {"none", "encode", "array", "fixed", "blob"};
+    constexpr int kernelCount = sizeof(kernels) / sizeof(kernels[0]);
+    vector<bool> failed(kernelCount);
+    vector<Result> results;
+
+    char path[] = "/tmp/rc5_compile_bench.XXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0)
+    {
+        cerr << "rc5_compile_bench: cannot create the blob file\n";
+        return 1;
+    }
+    close(fd);
+
+    mt19937 rng(5);
+    for (size_t bytes = 1024; bytes <= options.maxBytes; bytes *= 4)
+    {
+        if (!writeBlob(path, bytes, rng))
+        {
+            cerr << "rc5_compile_bench: cannot write the blob file\n";
+            break;
+        }
+        for (int kernel = 0; kernel < kernelCount; ++kernel)
+        {
+            const string mode = "compile-" + to_string(bytes);
+            const string label = string(kernels[kernel]) + "/32/12/16/" + mode;
+            if (failed[kernel] || (!options.filter.empty() && label.find(options.filter) == string::npos))
+                continue;
+
+            Result result{kernels[kernel], bytes, 0, {}};
+            for (int i = 0; i < options.repeats && !failed[kernel]; ++i)
+            {
+                const double ms = compile(kernel, bytes, path);
+                if (ms < 0)
+                    failed[kernel] = true;
+                result.samples.push_back(ms);
+            }
+            if (failed[kernel])
+            {
+                cerr << label << ": does not compile, dropped from here on\n";
+                continue;
+            }
+            result.value = median(result.samples);
+            cerr << label << ": " << fixed << setprecision(0) << result.value << " ms\n";
+            results.push_back(move(result));
+        }
+    }
+    unlink(path);
+
+    cout << "{\n  \"cxx\": \"" << options.cxx << "\",\n  \"repeats\": " << options.repeats << ",\n  \"results\": [\n";
+    cout << setprecision(6) << defaultfloat;
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const Result &res = results[i];
+        cout << "    {\"kernel\": \"" << res.kernel << "\", \"w\": 32, \"r\": 12, \"b\": 16, \"mode\": \"compile-" << res.bytes
+             << "\", \"unit\": \"ms\", \"value\": " << res.value << ", \"samples\": [";
+        for (size_t j = 0; j < res.samples.size(); ++j)
+            cout << (j ? ", " : "") << res.samples[j];
+        cout << "]}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    cout << "  ]\n}\n";
+    return 0;
+}
+
+#endif
@@ -0,0 +1,177 @@
+#include "RC5SearchRunner.hpp"
+
+#include <csignal>
+#include <iomanip>
+
+//////// KEY SEARCH TOOL
+
+// rc5_search --plaintext HEX --ciphertext HEX --start HEX --count N
+//            [--unit N] [--threads N] [--journal PATH] [--interval SECONDS]
+//
+// searches count RC5-32/12 keys from start on for the one that encrypts the
+// plaintext block to the ciphertext block; the key length is the length of
+// start (1 to 16 bytes). The journal (default rc5_search.journal) records the
+// searched units, so an interrupted search picks up where it stopped when
+// run again with the same arguments. Prints the key and exits with 0 when it
+// is found, 1 when the range is exhausted, 3 when interrupted, 2 on bad input
+
+struct Options
+{
+    string plaintext, ciphertext, start;
+    uint64_t count = 0;
+    uint64_t unit = uint64_t(1) << 20;
+    unsigned threads = thread::hardware_concurrency();
+    string journal = "rc5_search.journal";
+    int interval = 10;
+};
+
+static Options options;
+static atomic<bool> interrupted{false};
+
+// "1.2 M"
+string rate(double value)
+{
+    ostringstream out;
+    out << fixed << setprecision(1);
+    if (value >= 1e9)
+        out << value / 1e9 << " G";
+    else if (value >= 1e6)
+        out << value / 1e6 << " M";
+    else
+        out << value / 1e3 << " k";
+    return out.str();
+}
+
+string duration(double seconds)
+{
+    const uint64_t s = seconds;
+    ostringstream out;
+    if (s >= 86400)
+        out << s / 86400 << "d";
+    if (s >= 3600)
+        out << s / 3600 % 24 << "h";
+    if (s >= 60)
+        out << s / 60 % 60 << "m";
+    out << s % 60 << "s";
+    return out.str();
+}
+
+template <uint8_t b>
+int search()
+{
+    using Runner = RC5SearchRunner<32, 12, b>;
+    typename Runner::Job job;
+    if (!Runner::fromHex(options.start, job.start.data(), b) ||
+        !Runner::fromHex(options.plaintext, job.plaintext.data(), job.plaintext.size()) ||
+        !Runner::fromHex(options.ciphertext, job.ciphertext.data(), job.ciphertext.size()))
+    {
+        cerr << "rc5_search: blocks are 8 bytes of hex, keys 1 to 16 bytes\n";
+        return 2;
+    }
+    job.count = options.count;
+    job.unitKeys = options.unit;
+
+    try
+    {
+        Runner runner(job, options.journal, options.threads);
+        cerr << "rc5_search: " << runner.unitsDone() << " of " << job.units() << " units already searched\n";
+
+        // the signal only sets a flag, a watcher thread passes it on
+        atomic<bool> finished{false};
+        thread watcher([&] {
+            while (!finished)
+            {
+                if (interrupted)
+                    runner.stop();
+                this_thread::sleep_for(chrono::milliseconds(50));
+            }
+        });
+
+        const auto result = runner.run(
+            [](const typename Runner::Progress &progress) {
+                const double fraction = double(progress.unitsDone) / progress.units;
+                cerr << "rc5_search: " << progress.unitsDone << "/" << progress.units << " units (" << fixed << setprecision(1)
+                     << 100 * fraction << "%), " << rate(progress.keysPerSecond) << "keys/s";
+                if (progress.keysPerSecond > 0 && progress.unitsDone < progress.units)
+                    cerr << ", eta " << duration((progress.units - progress.unitsDone) * double(options.unit) / progress.keysPerSecond);
+                cerr << "\n";
+            },
+            chrono::seconds(options.interval));
+        finished = true;
+        watcher.join();
+
+        if (result.found)
+        {
+            cout << Runner::toHex(result.key.data(), b) << "\n";
+            return 0;
+        }
+        return result.complete ? 1 : 3;
+    }
+    catch (const exception &e)
+    {
+        cerr << "rc5_search: " << e.what() << "\n";
+        return 2;
+    }
+}
+
+template <uint8_t... b>
+int dispatch(size_t keyBytes, integer_sequence<uint8_t, b...>)
+{
+    int status = 2;
+    ((keyBytes == b + 1 ? (status = search<b + 1>(), true) : false) || ...);
+    return status;
+}
+
+int usage(const char *name)
+{
+    cerr << "usage: " << name << " --plaintext HEX --ciphertext HEX --start HEX --count N"
+         << " [--unit N] [--threads N] [--journal PATH] [--interval SECONDS]\n";
+    return 2;
+}
+
+int main(int argc, char **argv)
+{
+    try
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const string arg = argv[i];
+            const bool value = i + 1 < argc;
+            if (arg == "--plaintext" && value)
+                options.plaintext = argv[++i];
+            else if (arg == "--ciphertext" && value)
+                options.ciphertext = argv[++i];
+            else if (arg == "--start" && value)
+                options.start = argv[++i];
+            else if (arg == "--count" && value)
+                options.count = stoull(argv[++i]);
+            else if (arg == "--unit" && value)
+                options.unit = max<uint64_t>(1, stoull(argv[++i]));
+            else if (arg == "--threads" && value)
+                options.threads = max(1, stoi(argv[++i]));
+            else if (arg == "--journal" && value)
+                options.journal = argv[++i];
+            else if (arg == "--interval" && value)
+                options.interval = max(1, stoi(argv[++i]));
+            else
+                return usage(argv[0]);
+        }
+    }
+    catch (const logic_error &)
+    {
+        // a number that is not one, or out of range (stoi and friends)
+        return usage(argv[0]);
+    }
+    if (options.plaintext.empty() || options.ciphertext.empty() || options.start.empty() || !options.count)
+        return usage(argv[0]);
+    if (options.start.size() % 2 || options.start.size() < 2 || options.start.size() > 32)
+    {
+        cerr << "rc5_search: the start key must be 1 to 16 bytes of hex\n";
+        return 2;
+    }
+
+    signal(SIGINT, [](int) { interrupted = true; });
+    signal(SIGTERM, [](int) { interrupted = true; });
+
+    return dispatch(options.start.size() / 2, make_integer_sequence<uint8_t, 16>{});
+}